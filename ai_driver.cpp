@@ -0,0 +1,152 @@
+#include "pch.h"
+#include "ai_driver.h"
+#include "car.h"
+#include "timeus.h"
+#include "btBulletDynamicsCommon.h"
+#include <algorithm>
+#include <cmath>
+using namespace std;
+
+static const float STEP = 4.f;  // m between path points
+static const float G = 9.81f;
+
+
+AI_DRIVERS::AI_DRIVERS()
+	: carsPerTick(0), grip(0.9f), maxSpeed(80.f)
+	, updates(0), ticks(0), us(0), perTick(0)
+	, loop(true), next(0)
+{	}
+
+float AI_DRIVERS::Step()
+{
+	return STEP;
+}
+
+void AI_DRIVERS::SetPath(const vector<MATHVECTOR<float,3> >& pts, bool looped)
+{
+	path.clear();
+	if (pts.size() < 2)  return;
+	path = pts;
+	loop = looped;
+	for (size_t i = 0; i < drivers.size(); ++i)
+		drivers[i].seg = -1;
+}
+
+void AI_DRIVERS::Build(list<CAR>& cars, const vector<char>& aiById)
+{
+	drivers.clear();  byId.clear();
+	next = 0;
+	for (list<CAR>::iterator it = cars.begin(); it != cars.end(); ++it)
+	{
+		if (it->id < 0 || it->id >= (int)aiById.size() || !aiById[it->id])  continue;
+		DRIVER d;
+		d.car = &*it;  d.seg = -1;
+		d.in.hasThrottle = d.in.hasBrake = d.in.hasSteer = true;
+		d.in.throttle = 0.f;  d.in.brake = 1.f;  d.in.steer = 0.f;
+		if (it->id >= (int)byId.size())
+			byId.resize(it->id + 1, -1);
+		byId[it->id] = (int)drivers.size();
+		drivers.push_back(d);
+	}
+}
+
+void AI_DRIVERS::Clear()
+{
+	drivers.clear();  byId.clear();
+	path.clear();
+}
+
+
+///  stage, round robin, same cars each tick for the same race
+//-----------------------------------------------------------
+void AI_DRIVERS::Update(WORKER_POOL& pool)
+{
+	unsigned int n = (unsigned int)drivers.size();
+	if (n == 0 || path.empty())  return;
+
+	unsigned int cnt = carsPerTick > 0 ? min(n, carsPerTick) : n;
+
+	unsigned long long t = GetTimeUs();
+	pool.For((int)cnt, *this);
+	us += GetTimeUs() - t;  // stats only
+
+	next = (next + cnt) % n;
+	perTick = cnt;  updates += cnt;  ++ticks;
+}
+
+void AI_DRIVERS::Run(int i, int worker)
+{
+	Drive(drivers[(next + i) % drivers.size()]);
+}
+
+
+///  path
+//-----------------------------------------------------------
+int AI_DRIVERS::Nearest(const MATHVECTOR<float,3>& p, int from) const
+{
+	int n = (int)path.size(), best = 0;
+	float bd = 1e30f;
+	if (from >= 0)
+	{	//  near last one, cars don't jump
+		for (int k = -8; k <= 24; ++k)
+		{	int s = from + k;
+			if (loop)  s = (s % n + n) % n;
+			else if (s < 0 || s >= n)  continue;
+			float d = (path[s] - p).MagnitudeSquared();
+			if (d < bd)  {  bd = d;  best = s;  }
+		}
+		if (bd < 30.f*30.f)
+			return best;
+	}
+	//  start or car reset
+	for (int s = 0; s < n; ++s)
+	{	float d = (path[s] - p).MagnitudeSquared();
+		if (d < bd)  {  bd = d;  best = s;  }
+	}
+	return best;
+}
+
+int AI_DRIVERS::Ahead(int seg, float dist) const
+{
+	int n = (int)path.size(), s = seg + (int)(dist / STEP + 0.5f);
+	return loop ? s % n : min(s, n-1);
+}
+
+void AI_DRIVERS::Drive(DRIVER& d)
+{
+	const btRigidBody* body = d.car->dynamics.chassis;
+	const btVector3& bp = body->getCenterOfMassPosition();
+	MATHVECTOR<float,3> p(bp.x(), bp.y(), bp.z());
+	d.seg = Nearest(p, d.seg);
+	float v = body->getLinearVelocity().length();
+
+	//  steer to a point ahead, car space +x forward, +y left (as GetSpeedDir)
+	const MATHVECTOR<float,3>& tp = path[Ahead(d.seg, 8.f + v * 0.6f)];
+	btVector3 l = body->getWorldTransform().invXform(btVector3(tp[0], tp[1], tp[2]));
+	float ang = atan2f(l.y(), l.x());
+	d.in.steer = max(-1.f, min(1.f, -ang * 2.f));
+
+	//  speed: slowest corner within braking distance, reachable from here
+	float dec = grip * G * 0.8f, target = maxSpeed;
+	float look = 20.f + v * v / (2.f * dec);
+	int n = (int)path.size(), steps = min(n, (int)(look / STEP) + 1);
+	for (int k = 1; k < steps; ++k)
+	{
+		int s0 = Ahead(d.seg, (k-1) * STEP), s1 = Ahead(d.seg, k * STEP), s2 = Ahead(d.seg, (k+2) * STEP);
+		if (s1 == s2)  break;  // path end
+		MATHVECTOR<float,3> a = path[s1] - path[s0], b = path[s2] - path[s1];
+		float la = a.Magnitude(), lb = b.Magnitude();
+		if (la < 0.01f || lb < 0.01f)  continue;
+		float c = a.dot(b) / (la * lb);
+		float turn = acosf(max(-1.f, min(1.f, c)));
+		if (turn < 0.01f)  continue;
+		float r = lb / turn;  // radius
+		float vc = sqrtf(grip * G * r), s = k * STEP;
+		target = min(target, sqrtf(vc * vc + 2.f * dec * s));
+	}
+
+	if (v < target)
+	{	d.in.throttle = min(1.f, (target - v) * 0.5f);  d.in.brake = 0.f;  }
+	else
+	{	d.in.throttle = 0.f;  d.in.brake = min(1.f, (v - target) * 0.3f);  }
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "mathvector.h"
+#include "remote_cmd.h"
+#include "worker_pool.h"
+#include <list>
+#include <vector>
+
+class CAR;
+
+
+///  computer drivers for opponent cars
+//  follow a closed line of points (the road) looking ahead by speed,
+//  speed from curvature ahead and grip; output is a REMOTE_INPUT per car,
+//  applied in CarInputs like remote commands (which still override it)
+//
+//  cars are updated in parallel on the worker pool, round robin, carsPerTick
+//  each tick (a fixed count, not a time budget, so runs and replays of a
+//  command log drive the same); the rest keep last tick's inputs
+class AI_DRIVERS : public WORKER_POOL::JOB
+{
+public:
+	AI_DRIVERS();
+
+	//  game coords, already sampled every ~Step m along the road, used as is
+	static float Step();  // m
+	void SetPath(const std::vector<MATHVECTOR<float,3> >& points, bool looped);
+	bool HasPath() const  {  return !path.empty();  }
+
+	void Build(std::list<CAR>& cars, const std::vector<char>& aiById);  // race start
+	void Clear();
+	bool Active() const  {  return !drivers.empty();  }
+	int Cars() const  {  return (int)drivers.size();  }
+
+	void Update(WORKER_POOL& pool);  // before inputs, only reads cars
+	const REMOTE_INPUT* Input(int carId) const  // NULL if not driven
+	{	return carId >= 0 && carId < (int)byId.size() && byId[carId] >= 0 ? &drivers[byId[carId]].in : NULL;  }
+
+	unsigned int carsPerTick;  // 0 all cars each tick
+	float grip;  // lateral acceleration in g for corner speed
+	float maxSpeed;  // m/s
+
+	//  stats
+	unsigned long long updates, ticks, us;  // car updates, stage runs, stage time
+	unsigned int perTick;  // cars in last stage
+
+	virtual void Run(int i, int worker);
+
+private:
+	struct DRIVER
+	{	CAR* car;
+		int seg;  // nearest path point, searched from here
+		REMOTE_INPUT in;
+	};
+	std::vector<DRIVER> drivers;
+	std::vector<int> byId;  // car id -> driver, -1
+	std::vector<MATHVECTOR<float,3> > path;
+	bool loop;
+
+	unsigned int next;  // round robin start
+
+	int Nearest(const MATHVECTOR<float,3>& p, int from) const;
+	int Ahead(int seg, float dist) const;
+	void Drive(DRIVER& d);
+};
@@ -0,0 +1,62 @@
+#include "pch.h"
+#include "alloc_count.h"
+#include "atomic_ops.h"
+#include <cstdlib>
+#include <new>
+
+#ifdef ENABLE_ALLOC_COUNT
+
+//  plain zero-initialized globals, usable before any static ctor runs
+static volatile unsigned long long gAllocs = 0, gBytes = 0;
+
+#define ALLOC_ADD(v,n)  AtomicAdd(v, (unsigned long long)(n))
+
+//  no dynamic exception specs on new (ill-formed from c++17), delete never throws
+#if __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1900)
+	#define ALLOC_NOTHROW  noexcept
+#else
+	#define ALLOC_NOTHROW  throw()
+#endif
+
+void* operator new(std::size_t size)
+{
+	ALLOC_ADD(gAllocs, 1);  ALLOC_ADD(gBytes, size);
+	void* p = std::malloc(size ? size : 1);
+	if (!p)  throw std::bad_alloc();
+	return p;
+}
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+void* operator new(std::size_t size, const std::nothrow_t&) ALLOC_NOTHROW
+{
+	ALLOC_ADD(gAllocs, 1);  ALLOC_ADD(gBytes, size);
+	return std::malloc(size ? size : 1);
+}
+void* operator new[](std::size_t size, const std::nothrow_t& nt) ALLOC_NOTHROW
+{
+	return operator new(size, nt);
+}
+void operator delete(void* p) ALLOC_NOTHROW  {  std::free(p);  }
+void operator delete[](void* p) ALLOC_NOTHROW  {  std::free(p);  }
+void operator delete(void* p, const std::nothrow_t&) ALLOC_NOTHROW  {  std::free(p);  }
+void operator delete[](void* p, const std::nothrow_t&) ALLOC_NOTHROW  {  std::free(p);  }
+
+namespace alloc_count
+{
+	bool Enabled()  {  return true;  }
+	unsigned long long Allocs()  {  return gAllocs;  }
+	unsigned long long Bytes()   {  return gBytes;  }
+}
+
+#else
+
+namespace alloc_count
+{
+	bool Enabled()  {  return false;  }
+	unsigned long long Allocs()  {  return 0;  }
+	unsigned long long Bytes()   {  return 0;  }
+}
+
+#endif
@@ -0,0 +1,11 @@
+#pragma once
+
+///  global heap allocation counters
+//  off by default, build with ENABLE_ALLOC_COUNT to replace
+//  operator new/delete in alloc_count.cpp and count (benchmarks)
+namespace alloc_count
+{
+	bool Enabled();
+	unsigned long long Allocs();  // operator new calls since start
+	unsigned long long Bytes();   // bytes requested since start
+}
@@ -0,0 +1,203 @@
+#include "pch.h"
+#include "async_log.h"
+#include "atomic_ops.h"
+#include "timeus.h"
+#include <sstream>
+#include <cstring>
+
+namespace logging
+{
+
+static asynclog* sLog = NULL;
+
+
+///  queue
+//-----------------------------------------------------------
+asynclog::asynclog()
+	: pushPos(0), writePos(0), thread(NULL), quit(false), level(LOG_INFO), rate(0)
+{
+	slots = new SLOT[SLOTS];
+	for (unsigned int i = 0; i < SLOTS; ++i)
+	{	slots[i].seq = i;  slots[i].out = NULL;  }
+	sLog = this;
+	StartThread();
+}
+
+asynclog::~asynclog()
+{
+	quit = true;
+	thread->join();
+	delete thread;
+	WriteSome();
+	delete[] slots;
+	if (sLog == this)
+		sLog = NULL;
+}
+
+asynclog* asynclog::Get()
+{
+	return sLog;
+}
+
+void asynclog::StartThread()
+{
+	thread = new boost::thread(&asynclog::Run, this);
+}
+
+void asynclog::AfterFork()
+{
+	//  the parent's writer doesn't exist here, its handle can't be
+	//  joined or detached (no such thread), so it is left as is
+	StartThread();
+}
+
+void asynclog::Push(std::ostream& out, std::string& line)
+{
+	unsigned int pos = pushPos;
+	SLOT* s;
+	while (true)
+	{
+		s = &slots[pos & (SLOTS-1)];
+		unsigned int seq = s->seq;
+		AtomicFence();
+		int dif = (int)(seq - pos);  // positions wrap
+		if (dif == 0)
+		{	if (AtomicCas(pushPos, pos, pos + 1))
+				break;  // slot is ours
+		}
+		else if (dif < 0)
+			boost::this_thread::yield();  // full, writer is behind
+		pos = pushPos;
+	}
+	s->out = &out;
+	s->line.swap(line);  // cleared by the writer
+	AtomicFence();
+	s->seq = pos + 1;  // writer sees it from here
+}
+
+//  writer thread, true if anything was written
+bool asynclog::WriteSome()
+{
+	bool any = false;
+	std::ostream* last = NULL;
+	while (true)
+	{
+		SLOT& s = slots[writePos & (SLOTS-1)];
+		if (s.seq != writePos + 1)
+			break;  // empty, or claimed and not yet filled
+		AtomicFence();
+		*s.out << s.line;
+		if (last && last != s.out)
+			last->flush();
+		last = s.out;
+
+		s.line.clear();  s.out = NULL;
+		AtomicFence();
+		s.seq = writePos + SLOTS;  // free for the push one lap later
+		++writePos;
+		any = true;
+	}
+	if (last)
+		last->flush();
+	return any;
+}
+
+void asynclog::Run()
+{
+	while (!quit)
+	{
+		if (!WriteSome())
+			boost::this_thread::sleep(boost::posix_time::milliseconds(2));
+	}
+}
+
+void asynclog::Flush()
+{
+	while (writePos != pushPos)
+		boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+}
+
+
+///  stream buffer
+//-----------------------------------------------------------
+asynclogbuf::asynclogbuf(const std::string& prefix1, LEVEL level1, std::ostream& out1, asynclog& log1)
+	: prefix(prefix1), level(level1), out(out1), log(log1)
+{	}
+
+asynclogbuf::LINE& asynclogbuf::Line()
+{
+	LINE* l = lines.get();
+	if (!l)
+	{	l = new LINE;
+		lines.reset(l);
+	}
+	return *l;
+}
+
+void asynclogbuf::Put(LINE& l)
+{
+	if (level < log.Level())
+	{	l.text.clear();
+		return;
+	}
+	//  rate limit, one window per second
+	unsigned long long sec = GetTimeUs() / 1000000;
+	if (sec != l.second)
+	{
+		if (l.dropped > 0)
+		{	std::ostringstream s;
+			s << prefix << "(" << l.dropped << " log lines dropped)\n";
+			l.send = s.str();
+			log.Push(out, l.send);
+		}
+		l.second = sec;  l.count = 0;  l.dropped = 0;
+	}
+	if (level < LOG_ERROR && log.Rate() > 0 && ++l.count > log.Rate())
+	{	++l.dropped;
+		l.text.clear();
+		return;
+	}
+	l.send.assign(prefix);
+	l.send += l.text;
+	l.text.clear();
+	log.Push(out, l.send);
+}
+
+int asynclogbuf::overflow(int c)
+{
+	if (c == traits_type::eof())
+		return traits_type::not_eof(c);
+	LINE& l = Line();
+	l.text += (char)c;
+	if (c == '\n')
+		Put(l);
+	return c;
+}
+
+std::streamsize asynclogbuf::xsputn(const char* s, std::streamsize n)
+{
+	LINE& l = Line();
+	std::streamsize i = 0;
+	while (i < n)
+	{
+		const char* nl = (const char*)memchr(s + i, '\n', n - i);
+		std::streamsize end = nl ? nl - s + 1 : n;
+		l.text.append(s + i, end - i);
+		if (nl)
+			Put(l);
+		i = end;
+	}
+	return n;
+}
+
+int asynclogbuf::sync()
+{
+	LINE& l = Line();
+	if (!l.text.empty())
+	{	l.text += '\n';
+		Put(l);
+	}
+	return 0;
+}
+
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <string>
+#include <ostream>
+#include <streambuf>
+#include <boost/thread.hpp>
+#include <boost/thread/tss.hpp>
+
+namespace logging
+{
+
+enum LEVEL
+{	LOG_INFO = 0, LOG_ERROR  };
+
+
+///  log lines queue, written by a background thread
+//  lock free ring of slots (many threads push, the writer pops), so logging
+//  never waits for the terminal or disk; slot strings keep their capacity and
+//  are swapped with the caller's, no heap work once warm; one per process (Get)
+class asynclog
+{
+public:
+	asynclog();
+	~asynclog();  // writes what is left
+
+	static asynclog* Get();
+
+	//  takes the line, it is written to out later
+	//  line gets an empty string back (with the capacity of an old one)
+	//  waits only if all slots are full
+	void Push(std::ostream& out, std::string& line);
+
+	//  wait until all queued lines are written
+	void Flush();
+	//  in a fork child: writer thread is not copied, start a new one
+	void AfterFork();
+
+	void SetLevel(LEVEL l)  {  level = l;  }
+	LEVEL Level() const  {  return level;  }
+	//  lines per second, per thread and stream, 0 unlimited (errors never dropped)
+	void SetRate(unsigned int r)  {  rate = r;  }
+	unsigned int Rate() const  {  return rate;  }
+
+private:
+	enum {  SLOTS = 4096  };  // power of 2
+	struct SLOT
+	{	volatile unsigned int seq;  // == pos: free for push pos, == pos+1: full
+		std::ostream* out;
+		std::string line;
+	};
+	SLOT* slots;
+	volatile unsigned int pushPos;  // next to claim, any thread
+	volatile unsigned int writePos;  // next to write, writer only
+
+	bool WriteSome();
+	void Run();
+	void StartThread();
+
+	boost::thread* thread;  // not deleted after fork, the parent's handle
+	volatile bool quit;
+	volatile LEVEL level;
+	volatile unsigned int rate;
+};
+
+
+///  log stream buffer, like logstreambuf: a prefix on each line
+//  text collects per thread, each whole line goes to the queue
+class asynclogbuf : public std::streambuf
+{
+public:
+	asynclogbuf(const std::string& prefix, LEVEL level, std::ostream& out, asynclog& log);
+
+protected:
+	virtual int overflow(int c);
+	virtual std::streamsize xsputn(const char* s, std::streamsize n);
+	virtual int sync();
+
+private:
+	struct LINE
+	{	std::string text, send;  // send is swapped into the queue
+		unsigned long long second;  // rate window
+		unsigned int count, dropped;
+		LINE() : second(0), count(0), dropped(0)  {  }
+	};
+	LINE& Line();
+	void Put(LINE& l);
+
+	std::string prefix;
+	LEVEL level;
+	std::ostream& out;
+	asynclog& log;
+	boost::thread_specific_ptr<LINE> lines;
+};
+
+}
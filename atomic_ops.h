@@ -0,0 +1,89 @@
+#pragma once
+#ifdef _MSC_VER
+	#include <intrin.h>
+#endif
+
+
+///  the few atomic ops the lock free counters, flags and rings here use
+//  gcc/clang __sync builtins, msvc Interlocked intrinsics (64 bit ones as
+//  compare exchange loops, so 32 bit windows builds have them too)
+//  all are full barriers
+
+#ifdef _MSC_VER
+
+inline int AtomicAdd(volatile int& v, int n)  // returns old value
+{
+	return (int)_InterlockedExchangeAdd((volatile long*)&v, (long)n);
+}
+
+inline long long AtomicAdd(volatile long long& v, long long n)
+{
+	long long o;
+	do  o = v;
+	while (_InterlockedCompareExchange64((volatile __int64*)&v, o + n, o) != o);
+	return o;
+}
+
+inline unsigned long long AtomicAdd(volatile unsigned long long& v, unsigned long long n)
+{
+	return (unsigned long long)AtomicAdd((volatile long long&)v, (long long)n);
+}
+
+inline bool AtomicCas(volatile unsigned int& v, unsigned int old, unsigned int val)
+{
+	return (unsigned int)_InterlockedCompareExchange((volatile long*)&v, (long)val, (long)old) == old;
+}
+
+inline long long AtomicLoad(const volatile long long& v)
+{
+	return _InterlockedCompareExchange64((volatile __int64*)&v, 0, 0);
+}
+
+inline unsigned long long AtomicLoad(const volatile unsigned long long& v)
+{
+	return (unsigned long long)AtomicLoad((const volatile long long&)v);
+}
+
+inline void AtomicStore(volatile long long& v, long long n)
+{
+	long long o;
+	do  o = v;
+	while (_InterlockedCompareExchange64((volatile __int64*)&v, n, o) != o);
+}
+
+inline void AtomicFence()
+{
+	long f = 0;
+	_InterlockedExchange(&f, 1);
+}
+
+#else
+
+inline int AtomicAdd(volatile int& v, int n)  {  return __sync_fetch_and_add(&v, n);  }
+inline long long AtomicAdd(volatile long long& v, long long n)  {  return __sync_fetch_and_add(&v, n);  }
+inline unsigned long long AtomicAdd(volatile unsigned long long& v, unsigned long long n)  {  return __sync_fetch_and_add(&v, n);  }
+
+inline bool AtomicCas(volatile unsigned int& v, unsigned int old, unsigned int val)
+{
+	return __sync_bool_compare_and_swap(&v, old, val);
+}
+
+inline long long AtomicLoad(const volatile long long& v)
+{
+	return __sync_fetch_and_add(const_cast<volatile long long*>(&v), 0);
+}
+
+inline unsigned long long AtomicLoad(const volatile unsigned long long& v)
+{
+	return __sync_fetch_and_add(const_cast<volatile unsigned long long*>(&v), 0);
+}
+
+inline void AtomicStore(volatile long long& v, long long n)
+{
+	__sync_lock_test_and_set(&v, n);
+	__sync_synchronize();  // test_and_set is only an acquire barrier
+}
+
+inline void AtomicFence()  {  __sync_synchronize();  }
+
+#endif
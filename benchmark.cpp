@@ -0,0 +1,193 @@
+#include "pch.h"
+#include "benchmark.h"
+#include "settings.h"
+#include "timeus.h"
+#include "alloc_count.h"
+#include "json_str.h"
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstdlib>
+using namespace std;
+
+
+BENCHMARK::BENCHMARK()
+	: reverse(false), frames(3000), next(0)
+	, ticks(0), cmdsScripted(0), cmdsProcessed(0)
+	, tickStart(0), allocStart(0), allocBytesStart(0)
+	, allocs(0), allocBytes(0), allocsMaxTick(0)
+	, inputUs(0), inputMaxUs(0), inputCars(0), inputTicks(0)
+{	}
+
+bool BENCHMARK::LoadScript(const string& path, ostream& error_output)
+{
+	ifstream f(path.c_str());
+	if (!f)
+	{	error_output << "Benchmark: can't open script: " << path << endl;
+		return false;
+	}
+	scriptPath = path;
+	script.clear();  cars.clear();  next = 0;
+
+	string line;  int ln = 0;
+	while (getline(f, line))
+	{
+		++ln;
+		size_t b = line.find_first_not_of(" \t\r");
+		if (b == string::npos || line[b] == '#')
+			continue;
+		line = line.substr(b, line.find_last_not_of(" \t\r") - b + 1);
+
+		if (line[0] >= '0' && line[0] <= '9')
+		{	//  frame command
+			size_t sp = line.find_first_of(" \t");
+			ENTRY e;
+			e.frame = (unsigned int)atoi(line.c_str());
+			if (sp == string::npos || !ParseRemoteCmd(line.substr(line.find_first_not_of(" \t", sp)), e.cmd))
+			{	error_output << "Benchmark: bad command in " << path << ":" << ln << ": " << line << endl;
+				return false;
+			}
+			script.push_back(e);
+			continue;
+		}
+		string key = line.substr(0, line.find_first_of(" \t")), val;
+		size_t v = line.find_first_not_of(" \t", key.length());
+		if (v != string::npos)  val = line.substr(v);
+
+		if (key == "track")			track = val;
+		else if (key == "reverse")	reverse = atoi(val.c_str()) != 0;
+		else if (key == "sim_mode")	sim_mode = val;
+		else if (key == "car")		cars.push_back(val);
+		else if (key == "frames")	frames = (unsigned int)atoi(val.c_str());
+		else
+			error_output << "Benchmark: unknown key in " << path << ":" << ln << ": " << key << endl;
+	}
+	if (track.empty() || cars.empty() || frames == 0)
+	{	error_output << "Benchmark: script needs track, car and frames: " << path << endl;
+		return false;
+	}
+	stable_sort(script.begin(), script.end(), SortByFrame);
+	tickUs.reserve(frames);
+	return true;
+}
+
+bool BENCHMARK::Configure(SETTINGS* settings, ostream& error_output) const
+{
+	const size_t maxCars = sizeof(settings->game.car) / sizeof(settings->game.car[0]);
+	if (cars.size() > maxCars)
+	{	error_output << "Benchmark: " << cars.size() << " car lines, at most " << maxCars << ": " << scriptPath << endl;
+		return false;
+	}
+	settings->gui.track = settings->game.track = track;
+	settings->gui.track_user = settings->game.track_user = false;
+	settings->gui.trackreverse = settings->game.trackreverse = reverse;
+	if (!sim_mode.empty())
+		settings->gui.sim_mode = settings->game.sim_mode = sim_mode;
+
+	settings->gui.local_players = settings->game.local_players = (int)cars.size();
+	for (size_t i = 0; i < cars.size(); ++i)
+		settings->gui.car[i] = settings->game.car[i] = cars[i];
+	settings->autostart = true;
+	return true;
+}
+
+void BENCHMARK::GetCmds(unsigned int frame, vector<REMOTE_CMD>& out)
+{
+	while (next < script.size() && script[next].frame <= frame)
+	{
+		out.push_back(script[next].cmd);
+		++next;  ++cmdsScripted;
+	}
+}
+
+
+///  timing
+//-----------------------------------------------------------
+void BENCHMARK::TickBegin()
+{
+	allocStart = alloc_count::Allocs();
+	allocBytesStart = alloc_count::Bytes();
+	tickStart = GetTimeUs();
+}
+
+void BENCHMARK::TickEnd(unsigned int cmds)
+{
+	unsigned long long t = GetTimeUs() - tickStart;
+	unsigned long long a = alloc_count::Allocs() - allocStart;
+	allocBytes += alloc_count::Bytes() - allocBytesStart;
+	allocs += a;
+	if (a > allocsMaxTick)  allocsMaxTick = a;
+
+	if (tickUs.size() < tickUs.capacity())
+		tickUs.push_back((float)t);
+	cmdsProcessed += cmds;
+	++ticks;
+}
+
+void BENCHMARK::InputTime(unsigned long long us, unsigned int cars)
+{
+	inputUs += us;  inputCars += cars;  ++inputTicks;
+	if (us > inputMaxUs)  inputMaxUs = us;
+}
+
+void BENCHMARK::SetRecord(int car, float record)
+{
+	if (car >= (int)laps.size())
+		laps.resize(car + 1);
+	laps[car].record = record;
+}
+
+void BENCHMARK::Lap(int car, float time)
+{
+	if (car < 0 || car >= (int)laps.size())  return;
+	LAPS& l = laps[car];
+	if (l.laps == 0 || time < l.best)
+		l.best = time;
+	++l.laps;
+}
+
+
+
+///  machine readable report  (json)
+//-----------------------------------------------------------
+bool BENCHMARK::WriteReport(const string& path, ostream& error_output) const
+{
+	vector<float> t = tickUs;
+	sort(t.begin(), t.end());
+	double sum = 0.0;
+	for (size_t i = 0; i < t.size(); ++i)
+		sum += t[i];
+	#define PCT(p)  (t.empty() ? 0.f : t[min(t.size()-1, (size_t)(t.size() * p))])
+
+	ofstream f(path.c_str());
+	if (!f)
+	{	error_output << "Benchmark: can't write report: " << path << endl;
+		return false;
+	}
+	f << "{\n"
+	  << "  \"script\": " << JsonStr(scriptPath) << ",\n"
+	  << "  \"track\": " << JsonStr(track) << ",\n"
+	  << "  \"reverse\": " << (reverse ? "true" : "false") << ",\n"
+	  << "  \"cars\": " << cars.size() << ",\n"
+	  << "  \"frames\": " << ticks << ",\n"
+	  << "  \"tick_us\": { \"min\": " << (t.empty() ? 0.f : t.front())
+	  << ", \"mean\": " << (t.empty() ? 0.0 : sum / t.size())
+	  << ", \"p50\": " << PCT(0.5) << ", \"p90\": " << PCT(0.9) << ", \"p99\": " << PCT(0.99)
+	  << ", \"max\": " << (t.empty() ? 0.f : t.back()) << " },\n"
+	  << "  \"allocs\": { \"counted\": " << (alloc_count::Enabled() ? "true" : "false")
+	  << ", \"total\": " << allocs << ", \"bytes\": " << allocBytes
+	  << ", \"per_tick\": " << (ticks ? (double)allocs / ticks : 0.0)
+	  << ", \"max_tick\": " << allocsMaxTick << " },\n"
+	  << "  \"input_us\": { \"mean\": " << (inputTicks ? (double)inputUs / inputTicks : 0.0)
+	  << ", \"per_car\": " << (inputCars ? (double)inputUs / inputCars : 0.0)
+	  << ", \"max\": " << inputMaxUs << " },\n"
+	  << "  \"commands\": { \"scripted\": " << cmdsScripted << ", \"processed\": " << cmdsProcessed << " },\n"
+	  << "  \"laps\": [";
+	for (size_t i = 0; i < laps.size(); ++i)
+		f << (i ? ", " : "") << "{ \"car\": " << i << ", \"laps\": " << laps[i].laps
+		  << ", \"best\": " << laps[i].best << ", \"record\": " << laps[i].record << " }";
+	f << "]\n"
+	  << "}\n";
+	#undef PCT
+	return true;
+}
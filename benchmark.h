@@ -0,0 +1,68 @@
+#pragma once
+#include "remote_cmd.h"
+#include <string>
+#include <vector>
+#include <ostream>
+
+class SETTINGS;
+
+
+///  scripted benchmark run
+//  loads a fixed track and car set, replays a command script through
+//  the remote command path and times a fixed number of physics frames
+//
+//  script file:
+//    # comment
+//    track Test1-Flat
+//    reverse 0
+//    sim_mode normal
+//    car ES
+//    frames 3000
+//    120 throttle 100      <- frame, then command as on the remote channel
+//    400 1:brake 50
+class BENCHMARK
+{
+public:
+	BENCHMARK();
+
+	bool LoadScript(const std::string& path, std::ostream& error_output);
+	//  set track and cars for next game, false if the script has more cars than settings hold
+	bool Configure(SETTINGS* settings, std::ostream& error_output) const;
+
+	//  add scripted commands for this race frame to out
+	void GetCmds(unsigned int frame, std::vector<REMOTE_CMD>& out);
+
+	void TickBegin();
+	void TickEnd(unsigned int cmdsProcessed);
+	void InputTime(unsigned long long us, unsigned int cars);  // input stage of a tick
+	//  car i in game order: best lap in records.bin before the run (0 none), laps done
+	void SetRecord(int car, float record);
+	void Lap(int car, float time);
+	bool Done() const  {  return ticks >= frames;  }
+
+	bool WriteReport(const std::string& path, std::ostream& error_output) const;
+
+	std::string scriptPath, track, sim_mode;
+	bool reverse;
+	std::vector<std::string> cars;
+	unsigned int frames;  // physics frames to run
+
+private:
+	struct ENTRY
+	{	unsigned int frame;  REMOTE_CMD cmd;  };
+	static bool SortByFrame(const ENTRY& a, const ENTRY& b)  {  return a.frame < b.frame;  }
+	std::vector<ENTRY> script;
+	size_t next;
+
+	//  stats
+	unsigned int ticks, cmdsScripted, cmdsProcessed;
+	std::vector<float> tickUs;  // reserved up front, no allocs while timing
+	unsigned long long tickStart, allocStart, allocBytesStart;
+	unsigned long long allocs, allocBytes, allocsMaxTick;
+	unsigned long long inputUs, inputMaxUs, inputCars, inputTicks;
+	struct LAPS
+	{	unsigned int laps;  float best, record;
+		LAPS() : laps(0), best(0.f), record(0.f)  {  }
+	};
+	std::vector<LAPS> laps;  // per car, sized at race start
+};
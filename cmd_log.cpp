@@ -0,0 +1,147 @@
+#include "pch.h"
+#include "cmd_log.h"
+#include <cstring>
+using namespace std;
+
+static const char sMagic[8] = {'S','R','C','M','D','L','G','2'};
+static const size_t FlushRecs = 256;  // wake writer after this many
+
+
+///  writer
+//-----------------------------------------------------------
+CMD_LOG_WRITER::CMD_LOG_WRITER()
+	: file(NULL), stop(false)
+{	}
+
+CMD_LOG_WRITER::~CMD_LOG_WRITER()
+{
+	Close();
+}
+
+bool CMD_LOG_WRITER::Open(const string& path, ostream& error_output)
+{
+	Close();
+	file = fopen(path.c_str(), "wb");
+	if (!file)
+	{	error_output << "Can't open command log for writing: " << path << endl;
+		return false;
+	}
+	fwrite(sMagic, 1, sizeof(sMagic), file);
+	front.reserve(FlushRecs * 4);  back.reserve(FlushRecs * 4);
+	stop = false;
+	thread = boost::thread(&CMD_LOG_WRITER::WriteThread, this);
+	return true;
+}
+
+void CMD_LOG_WRITER::Close()
+{
+	if (!file)  return;
+	{	boost::lock_guard<boost::mutex> lock(mutex);
+		stop = true;
+	}
+	cond.notify_one();
+	thread.join();
+	fclose(file);  file = NULL;
+}
+
+void CMD_LOG_WRITER::Add(const CMD_LOG_REC& r)
+{
+	bool wake;
+	{	boost::lock_guard<boost::mutex> lock(mutex);
+		front.push_back(r);
+		wake = front.size() >= FlushRecs;
+	}
+	if (wake)
+		cond.notify_one();
+}
+
+bool CMD_LOG_WRITER::Record(unsigned int frame, const REMOTE_CMD& cmd)
+{
+	if (!file)  return true;
+	if (cmd.car < -1 || cmd.car > 32767)
+		return false;
+	CMD_LOG_REC r;
+	memset(&r, 0, sizeof(r));
+	r.frame = frame;  r.type = (unsigned char)cmd.type;
+	r.car = (short)cmd.car;  r.param = (unsigned short)cmd.param;  r.value = cmd.value;
+	Add(r);
+	return true;
+}
+
+void CMD_LOG_WRITER::RaceStart()
+{
+	if (!file)  return;
+	CMD_LOG_REC r;
+	memset(&r, 0, sizeof(r));
+	Add(r);
+}
+
+//  swaps buffers and writes, at least every 0.5 sec
+void CMD_LOG_WRITER::WriteThread()
+{
+	bool done = false;
+	while (!done)
+	{
+		{	boost::unique_lock<boost::mutex> lock(mutex);
+			if (!stop && front.size() < FlushRecs)
+				cond.timed_wait(lock, boost::posix_time::milliseconds(500));
+			front.swap(back);
+			done = stop;
+		}
+		if (!back.empty())
+		{	fwrite(&back[0], sizeof(CMD_LOG_REC), back.size(), file);
+			fflush(file);
+			back.clear();
+		}
+	}
+}
+
+
+///  reader
+//-----------------------------------------------------------
+CMD_LOG_READER::CMD_LOG_READER()
+	: next(0), started(false)
+{	}
+
+bool CMD_LOG_READER::Load(const string& p, ostream& error_output)
+{
+	path = p;  recs.clear();  next = 0;  started = false;
+	FILE* f = fopen(p.c_str(), "rb");
+	if (!f)
+	{	error_output << "Can't open command log: " << p << endl;
+		return false;
+	}
+	char magic[sizeof(sMagic)];
+	if (fread(magic, 1, sizeof(magic), f) != sizeof(magic) || memcmp(magic, sMagic, sizeof(magic)) != 0)
+	{	error_output << "Not a command log (or an older format): " << p << endl;
+		fclose(f);  return false;
+	}
+	CMD_LOG_REC r;
+	while (fread(&r, sizeof(r), 1, f) == 1)
+		recs.push_back(r);
+	fclose(f);
+	return true;
+}
+
+void CMD_LOG_READER::RaceStart()
+{
+	while (next < recs.size() && recs[next].type != REMOTE_CMD::NONE)
+		++next;
+	if (next < recs.size())
+		++next;  // past marker
+	started = true;
+}
+
+void CMD_LOG_READER::GetCmds(unsigned int frame, vector<REMOTE_CMD>& out)
+{
+	if (!started)  return;
+	while (next < recs.size() && recs[next].type != REMOTE_CMD::NONE && recs[next].frame <= frame)
+	{
+		const CMD_LOG_REC& r = recs[next++];
+		REMOTE_CMD cmd;
+		cmd.type = r.type < REMOTE_CMD::ALL ? (REMOTE_CMD::TYPE)r.type : REMOTE_CMD::NONE;
+		cmd.car = r.car;  cmd.value = r.value;  cmd.param = (short)r.param;
+		if (cmd.type != REMOTE_CMD::NONE)
+			out.push_back(cmd);
+	}
+}
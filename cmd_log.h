@@ -0,0 +1,67 @@
+#pragma once
+#include "remote_cmd.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <boost/thread.hpp>
+
+
+///  binary log of applied remote commands
+//  file: 8 byte magic "SRCMDLG2", then fixed size records (16 bytes)
+//  a record with type NONE marks the start of a race, frames are race frames
+struct CMD_LOG_REC
+{
+	unsigned int frame;
+	unsigned char type, pad0;
+	short car;  // -1 no prefix
+	unsigned short param;  // REMOTE_CMD::param
+	unsigned short pad1;
+	float value;
+};
+
+
+///  buffered writer, file I/O done on its own thread
+class CMD_LOG_WRITER
+{
+public:
+	CMD_LOG_WRITER();
+	~CMD_LOG_WRITER();
+
+	bool Open(const std::string& path, std::ostream& error_output);
+	void Close();
+	bool IsOpen() const  {  return file != NULL;  }
+
+	//  game thread, only copies into the buffer; false if car id doesn't fit a record
+	bool Record(unsigned int frame, const REMOTE_CMD& cmd);
+	void RaceStart();
+
+private:
+	void Add(const CMD_LOG_REC& r);
+	void WriteThread();
+
+	FILE* file;
+	boost::thread thread;
+	boost::mutex mutex;
+	boost::condition_variable cond;
+	std::vector<CMD_LOG_REC> front, back;  // filled / being written
+	bool stop;
+};
+
+
+///  reads a whole log, returns commands per race and frame
+class CMD_LOG_READER
+{
+public:
+	CMD_LOG_READER();
+	bool Load(const std::string& path, std::ostream& error_output);
+
+	void RaceStart();  // go to next race in log
+	void GetCmds(unsigned int frame, std::vector<REMOTE_CMD>& out);
+
+	std::string path;
+private:
+	std::vector<CMD_LOG_REC> recs;
+	size_t next;
+	bool started;
+};
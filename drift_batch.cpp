@@ -0,0 +1,83 @@
+#include "pch.h"
+#include "drift_batch.h"
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+	#include <xmmintrin.h>
+	#define DRIFT_SSE
+#endif
+
+//  drift starts when the angle > 0.2 (around 11.5 degrees)
+//  drift ends when the angle < 0.1 (around 5.7 degrees)
+static const float cos2Start = 0.96053f;  // cos(0.2)^2
+static const float cos2End   = 0.99003f;  // cos(0.1)^2
+static const float minSpeed2 = 100.f;     // velocity must be above 10 m/s
+
+
+void DRIFT_BATCH::Resize(int cars)
+{
+	size_t n = (cars + 3) & ~3;  // whole SSE lanes, padding stays 0
+	fx.assign(n, 0.f);  fy.assign(n, 0.f);
+	vx.assign(n, 0.f);  vy.assign(n, 0.f);
+	cos2.assign(n, 0.f);  onTrack.assign(n, 0.f);
+	result.assign(n, 0);
+}
+
+void DRIFT_BATCH::Set(int i, const QUATERNION<float>& q, const MATHVECTOR<float,3>& vel,
+	bool track, bool wasDrifting)
+{
+	//  car's x axis rotated by q, on the horizontal plane
+	float x = q[0], y = q[1], z = q[2], w = q[3];
+	fx[i] = 1.f - 2.f * (y*y + z*z);
+	fy[i] = 2.f * (x*y + w*z);
+	vx[i] = vel[0];  vy[i] = vel[1];
+	cos2[i] = wasDrifting ? cos2End : cos2Start;
+	onTrack[i] = track ? 1.f : 0.f;
+}
+
+void DRIFT_BATCH::Compute()
+{
+	int n = (int)fx.size();
+#ifdef DRIFT_SSE
+	const __m128 zero = _mm_setzero_ps(), speed2 = _mm_set1_ps(minSpeed2);
+	for (int i = 0; i < n; i += 4)
+	{
+		__m128 ax = _mm_loadu_ps(&fx[i]), ay = _mm_loadu_ps(&fy[i]);
+		__m128 bx = _mm_loadu_ps(&vx[i]), by = _mm_loadu_ps(&vy[i]);
+		__m128 dot = _mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by));
+		__m128 ff  = _mm_add_ps(_mm_mul_ps(ax, ax), _mm_mul_ps(ay, ay));
+		__m128 vv  = _mm_add_ps(_mm_mul_ps(bx, bx), _mm_mul_ps(by, by));
+
+		__m128 ok = _mm_and_ps(_mm_cmpgt_ps(_mm_loadu_ps(&onTrack[i]), zero), _mm_cmpgt_ps(vv, speed2));
+		__m128 wide = _mm_cmplt_ps(_mm_mul_ps(dot, dot), _mm_mul_ps(_mm_loadu_ps(&cos2[i]), _mm_mul_ps(ff, vv)));
+		int drift = _mm_movemask_ps(_mm_and_ps(ok, _mm_and_ps(_mm_cmpge_ps(dot, zero), wide)));
+		int spin  = _mm_movemask_ps(_mm_and_ps(ok, _mm_cmplt_ps(dot, zero)));
+
+		for (int l = 0; l < 4; ++l)
+			result[i+l] = ((drift >> l) & 1) | (((spin >> l) & 1) << 1);
+	}
+#else
+	for (int i = 0; i < n; ++i)
+	{
+		float dot = fx[i]*vx[i] + fy[i]*vy[i];
+		float ff = fx[i]*fx[i] + fy[i]*fy[i], vv = vx[i]*vx[i] + vy[i]*vy[i];
+		bool ok = onTrack[i] > 0.f && vv > minSpeed2;
+		bool drift = ok && dot >= 0.f && dot*dot < cos2[i] * ff * vv;
+		bool spin = ok && dot < 0.f;
+		result[i] = (drift ? 1 : 0) | (spin ? 2 : 0);
+	}
+#endif
+}
+
+float DRIFT_BATCH::Speed(int i) const
+{
+	return sqrtf(vx[i]*vx[i] + vy[i]*vy[i]);
+}
+
+float DRIFT_BATCH::Angle(int i) const
+{
+	float mag = sqrtf((fx[i]*fx[i] + fy[i]*fy[i]) * (vx[i]*vx[i] + vy[i]*vy[i]));
+	if (mag <= 0.001f)  return 0.f;
+	float d = (fx[i]*vx[i] + fy[i]*vy[i]) / mag;
+	return acosf(d > 1.f ? 1.f : (d < -1.f ? -1.f : d));
+}
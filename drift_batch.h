@@ -0,0 +1,30 @@
+#pragma once
+#include "mathvector.h"
+#include "quaternion.h"
+#include <vector>
+
+
+///  drift test for all cars in one pass
+//  SoA arrays padded to 4, SSE when available, no sqrt or acos:
+//  angle(dir,vel) > thr  is  dot < cos(thr)*|dir|*|vel|,  compared squared for dot >= 0
+class DRIFT_BATCH
+{
+public:
+	void Resize(int cars);
+	void Set(int i, const QUATERNION<float>& rot, const MATHVECTOR<float,3>& vel,
+		bool onTrack, bool wasDrifting);
+	void Compute();
+
+	bool Drifting(int i) const  {  return (result[i] & 1) != 0;  }
+	bool SpinOut(int i) const   {  return (result[i] & 2) != 0;  }
+	bool OnTrack(int i) const   {  return onTrack[i] != 0.f;  }
+
+	//  only for drifting cars, needs sqrt and acos
+	float Speed(int i) const;
+	float Angle(int i) const;
+
+private:
+	//  horizontal car direction and velocity, cos^2 of angle threshold
+	std::vector<float> fx, fy, vx, vy, cos2, onTrack;
+	std::vector<unsigned char> result;  // bit 0 drifting, 1 spin out
+};
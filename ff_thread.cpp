@@ -0,0 +1,71 @@
+#include "pch.h"
+#include "ff_thread.h"
+#include "atomic_ops.h"
+#include "timeus.h"
+#include <cstring>
+
+
+FF_THREAD::FF_THREAD()
+	: maxUpdateUs(0), dev(NULL), period(0.02), error_output(NULL)
+	, force(0), updates(0), quit(false)
+{	}
+
+FF_THREAD::~FF_THREAD()
+{
+	Stop();
+}
+
+void FF_THREAD::Start(FF_DEVICE* device, double per, std::ostream& err)
+{
+	Stop();
+	dev = device;  period = per;  error_output = &err;
+	quit = false;
+	Set(0.0);
+	thread = boost::thread(&FF_THREAD::Run, this);
+}
+
+void FF_THREAD::Stop()
+{
+	if (!dev)  return;
+	quit = true;
+	thread.join();
+	dev->Update(0.0, period, *error_output);  // center
+	delete dev;
+	dev = NULL;
+}
+
+void FF_THREAD::Set(double f)
+{
+	long long bits;
+	memcpy(&bits, &f, sizeof(bits));
+	AtomicStore(force, bits);
+}
+
+double FF_THREAD::Get() const
+{
+	long long bits = AtomicLoad(force);
+	double f;
+	memcpy(&f, &bits, sizeof(f));
+	return f;
+}
+
+void FF_THREAD::Run()
+{
+	unsigned long long next = GetTimeUs(), step = (unsigned long long)(period * 1000000.0);
+	while (!quit)
+	{
+		unsigned long long t = GetTimeUs();
+		dev->Update(Get(), period, *error_output);
+		t = GetTimeUs() - t;
+		if (t > maxUpdateUs)  maxUpdateUs = t;
+		++updates;
+
+		//  fixed rate, skip missed ones after a stall
+		next += step;
+		unsigned long long now = GetTimeUs();
+		if (next > now)
+			boost::this_thread::sleep(boost::posix_time::microseconds(next - now));
+		else
+			next = now;
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <ostream>
+#include <boost/thread.hpp>
+
+
+///  force feedback output device
+class FF_DEVICE
+{
+public:
+	virtual ~FF_DEVICE()  {  }
+	//  force -1..1, may block on device I/O
+	virtual void Update(double force, double dt, std::ostream& error_output) = 0;
+};
+
+///  no hardware, keeps what it got (for tests and headless runs)
+class FF_NULL_DEVICE : public FF_DEVICE
+{
+public:
+	FF_NULL_DEVICE() : last(0.0), updates(0)  {  }
+	virtual void Update(double force, double dt, std::ostream& error_output)
+	{	last = force;  ++updates;  }
+
+	volatile double last;
+	volatile unsigned long long updates;
+};
+
+
+///  force feedback on its own thread
+//  game thread only stores the newest force (Set, no locks or I/O), the thread
+//  sends it to the device at a fixed rate, a slow device only delays itself
+class FF_THREAD
+{
+public:
+	FF_THREAD();
+	~FF_THREAD();
+
+	void Start(FF_DEVICE* device, double period, std::ostream& error_output);  // takes device
+	void Stop();
+	bool Running() const  {  return dev != NULL;  }
+
+	void Set(double force);
+	double Get() const;
+	unsigned long long Updates() const  {  return updates;  }
+	unsigned long long maxUpdateUs;  // longest device call
+
+private:
+	void Run();
+
+	FF_DEVICE* dev;
+	double period;
+	std::ostream* error_output;
+	volatile long long force;  // double bits, written whole
+	volatile unsigned long long updates;
+	volatile bool quit;
+	boost::thread thread;
+};
@@ -1,5 +1,6 @@
 #include "pch.h"
 #include "game.h"
+#include "timeus.h"
 #include "unittest.h"
 #include "joepack.h"
 #include "matrix4.h"
@@ -15,20 +16,41 @@
 #include "../ogre/common/Def_Str.h"
 #include "../ogre/common/data/SceneXml.h"
 #include "../ogre/common/CScene.h"
+#include "../road/Road.h"
 #include "../ogre/CGame.h"
 #include "../ogre/CInput.h"
 #include "../ogre/FollowCamera.h"
 #include "../oics/ICSInputControlSystem.h"
 #include <OgreTimer.h>
+#include <boost/bind.hpp>
 
 #define M_PI  3.14159265358979323846
 using namespace std;
 
 
+#ifdef ENABLE_FORCE_FEEDBACK
+///  sdl joystick force feedback, for FF_THREAD
+class FF_SDL_DEVICE : public FF_DEVICE
+{
+public:
+	FF_SDL_DEVICE(const string& device, ostream& error_output, ostream& info_output)
+		: ff(device, error_output, info_output)
+	{	}
+	virtual void Update(double force, double dt, ostream& error_output)
+	{
+		double pos = force;
+		ff.update(force, &pos, dt, error_output);
+	}
+private:
+	FORCEFEEDBACK ff;
+};
+#endif
+
+
 ///  ctor
 GAME::GAME(ostream & info_out, ostream & err_out, SETTINGS* pSettings) :
 	settings(pSettings), info_output(info_out), error_output(err_out),
-	frame(0), displayframe(0), clocktime(0), target_time(0),
+	frame(0), race_frame(0), displayframe(0), clocktime(0), target_time(0),
 	//framerate(0.01f),  ///~  0.004+  o:0.01
 	fps_track(10,0), fps_position(0), fps_min(0), fps_max(0),
 	multithreaded(false), benchmode(false), dumpfps(false),
@@ -38,21 +60,74 @@ GAME::GAME(ostream & info_out, ostream & err_out, SETTINGS* pSettings) :
 	framerate(1.0 / pSettings->game_fq),
 	app(NULL),
 	tire_ref_id(0),
-	reloadSimNeed(0),reloadSimDone(0)
+	reloadSimNeed(0),reloadSimDone(0),
+	remoteOneWay(false), remotePerTick(64), remotePort(5555), remoteApplied(0), metricsPort(0),
+	settingsKeep(false), farmWorkers(0), farmRunId(-1), farmNewGame(false),
+	trackKeep(true), patchBench(0), physicsThreads(1), aiFrom(-1),
+	soundLazy(false), soundCarLoaded(false), soundCarOk(false), soundCarMs(0),
+	ffNull(false), startupThreads(4)
 {
 	track.pGame = this;
 	carcontrols_local.first = NULL;
+	inputFn = &GAME::CarInputs<false, false>;
 	//  sim iv from settings
+	carInputs.resize(CARINPUT::ALL, 0.f);
 	collision.fixedTimestep = 1.0 / pSettings->blt_fq;
 	collision.maxSubsteps = pSettings->blt_iter;
+	InitMetrics();
+}
+
+void GAME::InitMetrics()
+{
+	mTicks = metrics.Counter("sr_ticks_total", "Game logic ticks simulated.");
+	mTicksDropped = metrics.Counter("sr_ticks_dropped_total", "Ticks not simulated, wall time thrown away below min fps.");
+	mTickUs = metrics.Histogram("sr_tick_us", "Game logic tick time, us.");
+	remote.received = metrics.Counter("sr_remote_cmds_received_total", "Remote commands parsed by the server thread.");
+	mCmdsDrained = metrics.Counter("sr_cmds_drained_total", "Commands taken for ticks, all sources.");
+	mCmdsApplied = metrics.Counter("sr_cmds_applied_total", "Commands applied to cars or sim data.");
+	mRemoteLatency = metrics.Histogram("sr_remote_latency_us", "Remote command receive to applied, us.");
+	mLoadTrackMs = metrics.Gauge("sr_load_track_ms", "Last LoadTrack time, ms.");
+	mReloadSimMs = metrics.Gauge("sr_reload_sim_ms", "Last ReloadSimData time, ms.");
+	mInitSoundMs = metrics.Gauge("sr_init_sound_ms", "InitializeSound time, ms.");
+	mCars = metrics.Gauge("sr_cars", "Cars in game.");
+	histPubUs = 0;  latencyNew = false;
 }
 
 
 //  start the game with the given arguments
-void GAME::Start(list <string> & args)
+bool GAME::Start(list <string> & args)
 {
+	unsigned long long t0 = GetTimeUs();
 	if (!ParseArguments(args))
-		return;
+		return false;
+	startup.Record("args", t0, GetTimeUs());
+
+	//  sim farm: tires and suspension loaded once here are shared with workers
+	//  after fork (before any startup threads), surfaces follow each run's track
+	if (farmWorkers > 0)
+	{
+		t0 = GetTimeUs();
+		StartCarsim();
+		sound.DisableAllSound();
+		bool ok;
+		logging::asynclog* log = logging::asynclog::Get();
+		if (log)  log->Flush();  // else queued lines print twice
+		int w = farm.Fork(farmWorkers, error_output, ok);
+		if (w >= 0 && log)
+			log->AfterFork();
+		if (!ok)
+			return false;
+		if (w < 0)
+		{	farm.RunMaster(farmSpecs, farmOut + "/farm_results.txt", info_output, error_output);
+			return false;
+		}
+		//  own ports, like the num argument in main
+		remotePort += w + 1;
+		settings->local_port += w + 1;
+		if (!FarmNextRun())
+			return false;
+		startup.Record("farm", t0, GetTimeUs());
+	}
 
 	info_output << "Starting VDrift-Ogre: 2010-05-01, O/S: ";
 	#ifdef _WIN32
@@ -67,36 +142,128 @@ void GAME::Start(list <string> & args)
 
 	carcontrols_local.second.Reset();
 
-	InitializeSound(); //if sound initialization fails, that's okay, it'll disable itself
+	//  stages touch separate data, only sdl init is kept in order (sound, then ff)
+	startup.Add("metrics", boost::bind(&GAME::StartMetrics, this));
+	startup.Add("records", boost::bind(&GAME::StartRecords, this));
+	startup.Add("physics", boost::bind(&GAME::StartPhysics, this));
+	startup.Add("carsim", boost::bind(&GAME::StartCarsim, this));
+	int snd = startup.Add("sound", boost::bind(&GAME::InitializeSound, this));  //if sound initialization fails, that's okay, it'll disable itself
+	startup.Add("options", boost::bind(&GAME::StartOptions, this));
+	startup.Add("forcefeedback", boost::bind(&GAME::StartForceFeedback, this), snd);
+	startup.Run(startupThreads);
+
+	info_output << startup.Summary() << endl;
+	if (!startupReport.empty())
+		startup.WriteReport(startupReport, error_output);
+	return true;
+}
+
+void GAME::StartMetrics()
+{
+	if (metricsPort <= 0)  return;
+	if (farm.IsWorker())
+		metricsPort += farm.index + 1;
+	if (metrics.Serve(metricsPort, error_output))
+		info_output << "Metrics: http://127.0.0.1:" << metricsPort << "/metrics" << endl;
+}
 
-	//initialize GUI
+//  one lap store for all sim modes, shared by farm workers
+//  only for benchmark and farm runs, races keep the text records
+void GAME::StartRecords()
+{
+	if (!bench.get())  return;
+	records.Open(PATHMANAGER::Records() + "/records.bin", error_output);
+}
+
+//  physics islands solved on worker threads
+void GAME::StartPhysics()
+{
+	if (physicsThreads <= 1)  return;
+	workers.Start(physicsThreads);
+	physicsSolver.reset(new PARALLEL_SOLVER(workers));
+	collision.world->setConstraintSolver(physicsSolver.get());
+	//  one solveGroup per island, bullet would batch small ones together (default 128)
+	btContactSolverInfo& si = collision.world->getSolverInfo();
+	si.m_minimumSolverBatchSize = 1;
+	//  order must come from the island alone, not a shared random sequence
+	si.m_solverMode &= ~SOLVER_RANDMIZE_ORDER;
+	info_output << "Physics: islands and ai on " << workers.Workers() << " threads" << endl;
+}
+
+//initialize GUI
+void GAME::StartOptions()
+{
 	map<string, string> optionmap;
 	LoadSaveOptions(LOAD, optionmap);
+}
 
-	//initialize force feedback
+//initialize force feedback, device updates on own thread
+void GAME::StartForceFeedback()
+{
+	if (ffNull)
+		ffThread.Start(new FF_NULL_DEVICE(), 0.02, error_output);
 	#ifdef ENABLE_FORCE_FEEDBACK
-		forcefeedback.reset(new FORCEFEEDBACK(settings->ff_device, error_output, info_output));
-		ff_update_time = 0;
+	else
+		ffThread.Start(new FF_SDL_DEVICE(settings->ff_device, error_output, info_output), 0.02, error_output);
 	#endif
-	
-	//ReloadSimData();  // later (need game.sim_mode)
 }
 
-void GAME::ReloadSimData()  /// New
+void GAME::ReloadSimData(bool force)  /// New
 {
-	LoadTires();
+	//  surfaces without a tire get the track's default (asphalt or gravel)
+	string surfKey = settings->game.sim_mode + "|" + track.sDefaultTire;
+	bool all = force || simDataMode != settings->game.sim_mode;
+	if (!all && simSurfKey == surfKey)
+		return;
+
+	Ogre::Timer ti;
+	if (all)
+	{	simDataMode = settings->game.sim_mode;
+		LoadTires();
+		LoadSusp();
+	}
+	simSurfKey = surfKey;
 	LoadAllSurfaces();
-	LoadSusp();
+	mReloadSimMs->Set(ti.getMicroseconds() * 0.001);
 
 	info_output << "Carsim: " << settings->game.sim_mode << ". Loaded: " << tires.size() << " tires, " << surfaces.size() << " surfaces, " << suspS.size() << "=" << suspD.size() << " suspensions." << endl;
 }
 
+///  startup: the track independent part, surfaces need the track's default tire
+//  and are loaded by ReloadSimData after the first track
+void GAME::StartCarsim()
+{
+	Ogre::Timer ti;
+	simDataMode = settings->game.sim_mode;
+	LoadTires();
+	LoadSusp();
+	mReloadSimMs->Set(ti.getMicroseconds() * 0.001);
+
+	info_output << "Carsim: " << settings->game.sim_mode << ". Loaded: " << tires.size() << " tires, " << suspS.size() << "=" << suspD.size() << " suspensions, surfaces with track." << endl;
+}
+
+
+//  same names in same order: copy values into the old elements, so pointers
+//  to them (surface tire, car surface) stay valid
+template <class T>
+static void KeepInPlace(vector<T>& cur, vector<T>& loaded)
+{
+	bool same = cur.size() == loaded.size();
+	for (size_t i = 0; same && i < cur.size(); ++i)
+		same = cur[i].name == loaded[i].name;
+	if (same)
+		for (size_t i = 0; i < cur.size(); ++i)
+			cur[i] = loaded[i];
+	else
+		cur.swap(loaded);
+}
+
 
 ///  Surfaces  all in data/cars/surfaces.cfg
 //------------------------------------------------------------------------------------------------------------------------------
 bool GAME::LoadAllSurfaces()
 {
-	surfaces.clear();
+	vector <TRACKSURFACE> loaded;
 	surf_map.clear();
 
 	string path, file = "/" + settings->game.sim_mode + "/surfaces.cfg";
@@ -159,9 +326,10 @@ bool GAME::LoadAllSurfaces()
 		///---
 		
 
-		surfaces.push_back(surf);
-		surf_map[surf.name] = (int)surfaces.size();  //+1, 0 = not found
+		loaded.push_back(surf);
+		surf_map[surf.name] = (int)loaded.size();  //+1, 0 = not found
 	}
+	KeepInPlace(surfaces, loaded);
 	return true;
 }
 
@@ -207,7 +375,7 @@ bool GAME::LoadTire(CARTIRE& ct, string path, string& file)
 
 bool GAME::LoadTires()
 {
-	tires.clear();
+	vector <CARTIRE> loaded;
 	tires_map.clear();
 	
 	//  load from both user and orig dirs
@@ -227,13 +395,14 @@ bool GAME::LoadTires()
 				ct.user = u;
 				if (LoadTire(ct, path, file))
 				{
-					tires.push_back(ct);
-					tires_map[file] = (int)tires.size();  //+1, 0 = not found
-					TRACKSURFACE::pTireDefault = &ct;  //-
+					loaded.push_back(ct);
+					tires_map[file] = (int)loaded.size();  //+1, 0 = not found
 				}else
 					LogO("Error Loading tire: "+file);
 			}
 	}	}
+	KeepInPlace(tires, loaded);
+	TRACKSURFACE::pTireDefault = tires.empty() ? 0 : &tires.back();  //-
 	return true;
 }
 CARTIRE* TRACKSURFACE::pTireDefault = 0;  //-
@@ -298,28 +467,9 @@ bool GAME::InitializeSound()
 		sound_lib.SetLibraryPath(PATHMANAGER::Sounds());
 		const SOUNDINFO & sdi = sound.GetDeviceInfo();
 
-		#define Lsnd(n)   if (!sound_lib.Load(n,1,sdi, error_output))  return false
-		#define Lsnd2(n,snd)  Lsnd(n);  \
+		#define Lsnd2(n,snd)  if (!sound_lib.Load(n,1,sdi, error_output))  return false;  \
 			if (!snd.Setup(sound_lib, n,	 error_output,  false, false,1.f))  return false;  \
 			sound.AddSource(snd);
-		
-		//  Load sounds ----
-		Lsnd("tire_squeal");  Lsnd("grass");  Lsnd("gravel");
-		
-		Lsnd("bump_front");  Lsnd("bump_rear");
-		Lsnd("wind");  Lsnd("boost");
-
-		for (i = 1; i <= Ncrashsounds; ++i)
-		{	std::string s = "crash/";  s += toStr(i/10)+toStr(i%10);
-			Lsnd(s);
-		}
-		Lsnd("crash/scrap");
-		Lsnd("crash/screech");
-
-		for (i = 0; i < Nwatersounds; ++i)
-			Lsnd("water"+toStr(i+1));
-
-		Lsnd("mud1");  Lsnd("mud_cont");  Lsnd("water_cont");
 
 		//  Hud 2d  ----
 		Lsnd2("hud/check", snd_chk);
@@ -337,8 +487,13 @@ bool GAME::InitializeSound()
 			sound.AddSource(snd_win[i]);
 		}
 		Lsnd2("hud/fail", snd_fail);
+		#undef Lsnd2
+
+		//  car sounds, in background or at first car load
+		soundCarLoaded = false;
+		if (!soundLazy)
+			soundLoader = boost::thread(&GAME::LoadCarSounds, this);
 
-		
 		sound.SetMasterVolume(settings->vol_master);
 		sound.Pause(false);
 		UpdHudSndVol();
@@ -349,10 +504,62 @@ bool GAME::InitializeSound()
 		return false;
 	}
 
+	mInitSoundMs->Set(ti.getMicroseconds() * 0.001);
 	info_output << "::: Time Sounds: " << fToStr(ti.getMilliseconds(),0,3) << " ms" << endl;
 	return true;
 }
 
+//  car samples, sound_lib is only used here until WaitCarSounds
+//  one fixed order, errors kept for the main thread
+void GAME::LoadCarSounds()
+{
+	Ogre::Timer ti;
+	const SOUNDINFO & sdi = sound.GetDeviceInfo();
+	soundCarOk = false;
+	soundCarLog.str("");
+	int i;
+	#define Lsnd(n)   if (!sound_lib.Load(n,1,sdi, soundCarLog))  return
+	
+	//  Load sounds ----
+	Lsnd("tire_squeal");  Lsnd("grass");  Lsnd("gravel");
+	
+	Lsnd("bump_front");  Lsnd("bump_rear");
+	Lsnd("wind");  Lsnd("boost");
+
+	for (i = 1; i <= Ncrashsounds; ++i)
+	{	std::string s = "crash/";  s += toStr(i/10)+toStr(i%10);
+		Lsnd(s);
+	}
+	Lsnd("crash/scrap");
+	Lsnd("crash/screech");
+
+	for (i = 0; i < Nwatersounds; ++i)
+		Lsnd("water"+toStr(i+1));
+
+	Lsnd("mud1");  Lsnd("mud_cont");  Lsnd("water_cont");
+	#undef Lsnd
+
+	soundCarMs = ti.getMilliseconds();
+	soundCarOk = true;
+}
+
+void GAME::WaitCarSounds()
+{
+	if (soundCarLoaded || !sound.Enabled())
+		return;
+	if (soundLoader.joinable())
+		soundLoader.join();
+	else
+		LoadCarSounds();  // lazy
+	soundCarLoaded = true;
+
+	if (!soundCarOk)
+	{	error_output << soundCarLog.str();
+		error_output << "Car sounds loading failed" << endl;
+	}else
+		info_output << "::: Time Car Sounds: " << fToStr(soundCarMs,0,3) << " ms" << endl;
+}
+
 void GAME::UpdHudSndVol()
 {
 	float g = settings->vol_hud;
@@ -378,15 +585,33 @@ void GAME::End()
 	if (profilingmode)
 		info_output << "Profiling summary:\n" << PROFILER.getSummary(quickprof::PERCENT) << endl;
 
+	if (voices.swaps > 0)
+		info_output << "Sound voices: " << voices.ActiveVoices() << " of " << voices.budget
+			<< " in use, " << voices.swaps << " car sound swaps" << endl;
+	if (ffThread.Running())
+	{	info_output << "Force feedback: " << ffThread.Updates() << " updates, longest " << ffThread.maxUpdateUs << " us" << endl;
+		ffThread.Set(0.0);
+		ffThread.Stop();
+	}
+	if (remoteLatency.Count() > 0)
+		info_output << "Remote cmd latency (receive to frame): " << remoteLatency.Summary()
+			<< ", tick " << (unsigned long long)(TickPeriod() * 1000000.0) << " us" << endl;
+
 	info_output << "Shutting down..." << endl;
 
 	LeaveGame();
+	cmdLog.Close();
+	shmCtl.Close();
+	metrics.Stop();
 
+	if (soundLoader.joinable())
+		soundLoader.join();
 	if (sound.Enabled())
 		sound.Pause(true); //stop the sound thread
 
-	///+
-	settings->Save(PATHMANAGER::SettingsFile()); //save settings first incase later deinits cause crashes
+	///+  benchmark and farm runs put their track and cars in settings, the user's stay
+	if (!settingsKeep)
+		settings->Save(PATHMANAGER::SettingsFile()); //save settings first incase later deinits cause crashes
 
 	collision.Clear();
 	track.Clear();
@@ -407,10 +632,17 @@ bool GAME::OneLoop(double dt)
 	if (reloadSimNeed)
 	{	// 	upd tweak tire save
 		reloadSimNeed = false;
-		ReloadSimData();
+		ReloadSimData(true);
 		reloadSimDone = true;
 	}	
 
+	if (farmNewGame)
+	{	// next farm run
+		farmNewGame = false;
+		app->NewGame();
+		return true;
+	}
+
 	PROFILER.beginBlock(" oneLoop");
 
 	clocktime += dt;  //only for stats
@@ -435,7 +667,9 @@ void GAME::Tick(double deltat)
 
 	//  throw away wall clock time if necessary to keep the framerate above the minimum
 	if (deltat > maxtime)
+	{	mTicksDropped->Add((unsigned long long)((deltat - maxtime) / framerate));
 		deltat = maxtime;
+	}
 		
 	//.  dont simulate before /network start
 	bool sim = app->iLoad1stFrames == -2 && (!timer.waiting || timer.end_sim);
@@ -453,7 +687,23 @@ void GAME::Tick(double deltat)
 	while (target_time > tickperriod && curticks < maxticks)
 	{
 		frame++;
+		bool timed = bench.get() && sim && !bench->Done();
+		if (timed)
+			bench->TickBegin();
+
+		unsigned long long t0 = GetTimeUs();
 		AdvanceGameLogic(sim ? tickperriod : 0.0);
+		unsigned long long t1 = GetTimeUs();
+		tickUs.Add(t1 - t0);
+		if (t1 >= histPubUs)
+			PublishHistograms(t1);
+		mTicks->Add();
+
+		if (timed)
+		{	bench->TickEnd(remoteApplied);
+			if (bench->Done())
+				BenchDone();
+		}
 
 		if (app)
 			app->newPoses(tickperriod);
@@ -463,6 +713,44 @@ void GAME::Tick(double deltat)
 	}
 }
 
+//  write report, then next farm run or exit
+void GAME::BenchDone()
+{
+	bool ok = bench->WriteReport(benchReport, error_output);
+	info_output << "Benchmark done, report: " << benchReport << endl;
+
+	if (farm.IsWorker())
+	{
+		farm.RunDone(farmRunId, ok, benchReport);
+		if (FarmNextRun())
+		{	farmNewGame = true;
+			return;
+		}
+	}
+	if (app)
+		app->mShutDown = true;
+}
+
+//  get next run from farm master, false when there are none
+bool GAME::FarmNextRun()
+{
+	string script;
+	while (farm.NextRun(script, farmRunId))
+	{
+		bench.reset(new BENCHMARK());
+		if (bench->LoadScript(script, error_output) && bench->Configure(settings, error_output))
+		{
+			settingsKeep = true;
+			benchReport = farmOut + "/run" + toStr(farmRunId) + ".json";
+			info_output << "Farm worker " << farm.index << ", run " << farmRunId << ": " << script << endl;
+			return true;
+		}
+		farm.RunDone(farmRunId, false, "");
+	}
+	bench.reset();
+	return false;
+}
+
 ///  simulate game by one frame
 //----------------------------------------------------------------------------------------------------------------------------
 void GAME::AdvanceGameLogic(double dt)
@@ -476,10 +764,24 @@ void GAME::AdvanceGameLogic(double dt)
 			if (sound.Enabled())
 				sound.Pause(false);
 
-			//PROFILER.beginBlock("ai");
-			//ai.Visualize(rootnode);
-			//ai.update(TickPeriod(), &track, cars); //-
-			//PROFILER.endBlock("ai");
+			ProcessRemoteCmds();
+
+			//  computer drivers, their inputs go in with the rest below
+			if (ai.Active())
+			{	PROFILER.beginBlock("ai");
+				if (!ai.HasPath())
+					LoadAiPath();
+				ai.Update(workers);
+				PROFILER.endBlock("ai");
+			}
+
+			//  inputs before physics, commands act in this frame
+			if (bench.get())
+			{	unsigned long long t0 = GetTimeUs();
+				UpdateCarInputs();
+				bench->InputTime(GetTimeUs() - t0, (unsigned int)cars.size());
+			}else
+				UpdateCarInputs();
 
 			PROFILER.beginBlock("-physics");
 			///~~  clear fluids for each car
@@ -499,11 +801,19 @@ void GAME::AdvanceGameLogic(double dt)
 			int i = 0;
 			for (list <CAR>::iterator it = cars.begin(); it != cars.end(); ++it, ++i)
 				UpdateCar(*it, TickPeriod());
+			UpdateDriftScores(TickPeriod());
+			if (sound.Enabled())
+				voices.Update(sound, carcontrols_local.first, TickPeriod());
 			PROFILER.endBlock("-car-sim");
 
 			//PROFILER.beginBlock("timer");
 			UpdateTimer();
 			//PROFILER.endBlock("timer");
+
+			if (dt > 0.0)
+			{	++race_frame;
+				PublishTelemetry();
+			}
 		}
 	}
 
@@ -511,46 +821,112 @@ void GAME::AdvanceGameLogic(double dt)
 }
 
 
-///  send inputs to the car, check for collisions, and so on
+///  ai line: road points, ogre to game coords
+void GAME::LoadAiPath()
+{
+	SplineRoad* road = app && app->scn ? app->scn->road : NULL;
+	if (!road || road->getNumPoints() < 2)
+		return;  // not yet
+	//  along the spline, not straight between its control points
+	int n = road->getNumPoints(), segs = road->isLooped ? n : n-1;
+	vector<MATHVECTOR<float,3> > pts;
+	for (int i = 0; i < segs; ++i)
+	{
+		Ogre::Real len = road->getPos(i).distance(road->getPos((i+1) % n));
+		int steps = max(1, (int)(len / AI_DRIVERS::Step() + 0.5f));
+		for (int k = 0; k < steps; ++k)
+		{	Ogre::Vector3 p = road->interpolate(i, Ogre::Real(k) / steps);
+			pts.push_back(MATHVECTOR<float,3>(p.x, -p.z, p.y));
+		}
+	}
+	if (!road->isLooped)
+	{	Ogre::Vector3 p = road->getPos(n-1);
+		pts.push_back(MATHVECTOR<float,3>(p.x, -p.z, p.y));
+	}
+	if (settings->game.trackreverse)
+		reverse(pts.begin(), pts.end());
+	ai.SetPath(pts, road->isLooped);
+	info_output << "AI path: " << pts.size() << " points on " << n << " road points" << endl;
+}
+
+
+///  check for collisions, and so on  (inputs are sent before physics)
 //-----------------------------------------------------------
 void GAME::UpdateCar(CAR & car, double dt)
 {
 	car.Update(dt);
-	UpdateCarInputs(car);
-	//UpdateDriftScore(car, dt);
 }
 
-void GAME::UpdateCarInputs(CAR & car)
+void GAME::UpdateCarInputs()
 {
-	vector <float> carinputs(CARINPUT::ALL, 0.0f);
+	//  the app starts a perf test without a settings change, one compare a tick
+	if (app->bPerfTest != inputCfg.perfTest)
+		UpdateInputCfg();
 	//  race countdown or loading
 	bool forceBrake = timer.waiting || timer.pretime > 0.f || app->iLoad1stFrames > -2;
 
-	int i = app->scn->sc->asphalt ? 1 : 0;
-	float sss_eff = settings->sss_effect[i], sss_velf = settings->sss_velfactor[i];
-	float carspeed = car.GetSpeedDir();  //car.GetSpeed();
-	//LogO(fToStr(car.GetSpeed(),2,6)+" "+fToStr(car.GetSpeedDir(),2,6));
-
 	boost::lock_guard<boost::mutex> lock(app->input->mPlayerInputStateMutex);
-	carinputs = carcontrols_local.second.ProcessInput(
-		app->input->mPlayerInputState[car.id], car.id,
-		carspeed, sss_eff, sss_velf,  app->mInputCtrlPlayer[car.id]->mbOneAxisThrottleBrake,
-		forceBrake, app->bPerfTest, app->iPerfTestStage);
+	(this->*inputFn)(forceBrake);
+}
 
-	car.HandleInputs(carinputs, TickPeriod());
+template <bool Ai, bool PerfTest>
+void GAME::CarInputs(bool forceBrake)
+{
+	const double dt = TickPeriod();
+	for (list <CAR>::iterator it = cars.begin(); it != cars.end(); ++it)
+	{
+		CAR& car = *it;
+		//  one axis can change in the input gui during a race
+		carInputs = carcontrols_local.second.ProcessInput(
+			app->input->mPlayerInputState[car.id], car.id,
+			car.GetSpeedDir(), inputCfg.sss_eff, inputCfg.sss_velf,
+			app->mInputCtrlPlayer[car.id]->mbOneAxisThrottleBrake,
+			forceBrake, PerfTest, app->iPerfTestStage);
+
+		if (Ai && !forceBrake)
+			if (const REMOTE_INPUT* in = ai.Input(car.id))
+				in->Apply(carInputs);
+		if (car.id < (int)remoteInputs.size())
+			remoteInputs[car.id].Apply(carInputs);
+
+		car.HandleInputs(carInputs, dt);
+	}
+}
+
+//  input settings, constant during a race
+void GAME::UpdateInputCfg()
+{
+	if (!app)
+		return;
+	if (app->scn)
+	{	int i = app->scn->sc->asphalt ? 1 : 0;
+		inputCfg.sss_eff = settings->sss_effect[i];
+		inputCfg.sss_velf = settings->sss_velfactor[i];
+	}
+	inputCfg.ai = ai.Active();
+	inputCfg.perfTest = app->bPerfTest;
+
+	inputFn = inputCfg.ai
+		? (inputCfg.perfTest ? &GAME::CarInputs<true, true> : &GAME::CarInputs<true, false>)
+		: (inputCfg.perfTest ? &GAME::CarInputs<false, true> : &GAME::CarInputs<false, false>);
 }
 
 
 bool GAME::NewGameDoCleanup()
 {
-	LeaveGame(); //this should clear out all data
+	LeaveGame(trackKeep); //this should clear out all data, track stays if same next
 	return true;
 }
 
 bool GAME::NewGameDoLoadTrack()
 {
+	Ogre::Timer ti;
 	if (!LoadTrack(settings->game.track))
 		error_output << "Error during track loading: " << settings->game.track << endl;
+	mLoadTrackMs->Set(ti.getMicroseconds() * 0.001);
+
+	//  surfaces for this track's default tire, nothing if already loaded for it
+	ReloadSimData();
 
 	return true;
 }
@@ -563,18 +939,48 @@ bool GAME::NewGameDoLoadMisc(float pre_time)
 
 	opponents.clear();
 
-	//send car sounds to the sound subsystem
+	race_frame = 0;
+	int maxId = -1;
 	for (list <CAR>::iterator i = cars.begin(); i != cars.end(); ++i)
-	{
-		list <SOUNDSOURCE *> soundlist;
-		i->GetSoundList(soundlist);
-		for (list <SOUNDSOURCE *>::iterator s = soundlist.begin(); s != soundlist.end(); ++s)
-			sound.AddSource(**s);
-	}
+		maxId = max(maxId, i->id);
+	remoteInputs.assign(maxId+1, REMOTE_INPUT());
+	cmdLog.RaceStart();
+	shmCtl.SetCars((unsigned int)cars.size());
+	remote.SetCars((unsigned int)cars.size());
+	mCars->Set(cars.size());
+	if (cmdReplay.get())
+		cmdReplay->RaceStart();
+
+	//  path comes from the road at first tick
+	ai.Build(cars, aiCars);
+	if (ai.Active())
+		info_output << "AI drivers: " << ai.Cars() << " cars" << endl;
+	UpdateInputCfg();  // after ai, picks the input loop
+
+	//send car sounds to the sound subsystem, nearest cars up to voice budget
+	voices.Build(cars, aiCars);
+	if (sound.Enabled())
+		voices.Update(sound, carcontrols_local.first, 0.f, true);
 
 	//load the timer
-	if (!timer.Load(PATHMANAGER::Records()+"/"+ settings->game.sim_mode+"/"+ settings->game.track+".txt", pre_time, error_output))
+	//  benchmark and farm runs don't read or rewrite the text records,
+	//  their laps and best times are in records.bin only
+	string recPath = bench.get() ? "" : PATHMANAGER::Records()+"/"+ settings->game.sim_mode+"/"+ settings->game.track+".txt";
+	if (!timer.Load(recPath, pre_time, error_output))
 		return false;
+	if (bench.get() && records.IsOpen())
+	{
+		records.Refresh();
+		recLaps.assign(cars.size(), 0);
+		int i = 0;
+		for (list <CAR>::iterator it = cars.begin(); it != cars.end(); ++it, ++i)
+		{
+			float best = 0.f;  unsigned int laps = 0;
+			if (records.Best(settings->game.track, settings->game.trackreverse, it->GetCarType(), settings->game.sim_mode, best, &laps))
+				info_output << "Record: " << it->GetCarType() << " " << fToStr(best,3,7) << " s, " << laps << " laps" << endl;
+			bench->SetRecord(i, best);
+		}
+	}
 
 	//add cars to the timer system
 	for (list <CAR>::iterator i = cars.begin(); i != cars.end(); ++i)
@@ -585,27 +991,38 @@ bool GAME::NewGameDoLoadMisc(float pre_time)
 }
 
 ///  clean up all game data
-void GAME::LeaveGame()
+void GAME::LeaveGame(bool keepTrack)
 {
-	//ai.clear_cars();
+	if (ai.Active())
+		info_output << "AI: " << ai.updates << " car updates in " << ai.ticks << " ticks, "
+			<< ai.us / max(1ull, ai.ticks) << " us per tick" << endl;
+	ai.Clear();
+	aiCars.clear();
 
 	carcontrols_local.first = NULL;
+	ffThread.Set(0.0);  // no car, center until the next race sets it
 
-	track.Unload();
-	collision.Clear();
-
-	if (sound.Enabled())
+	//  settings->game has the next track already
+	if (!keepTrack || trackResident.empty() || trackResident != TrackKey(settings->game.track))
 	{
-		for (list <CAR>::iterator i = cars.begin(); i != cars.end(); ++i)
-		{
-			list <SOUNDSOURCE *> soundlist;
-			i->GetSoundList(soundlist);
-			for (list <SOUNDSOURCE *>::iterator s = soundlist.begin(); s != soundlist.end(); s++)
-				sound.RemoveSource(*s);
-		}
+		track.Unload();
+		trackResident.clear();
+		patchIndex.Clear();
+	}
+	collision.Clear();  // also has scene objects, always rebuilt
+
+	if (voices.Buffers() > 0 && voices.swaps > 0)
+	{	info_output << "Sound voices per sample (now, peak):";
+		for (int b = 0; b < voices.Buffers(); ++b)
+			info_output << " " << voices.Buffer(b)->GetName() << " " << voices.BufferVoices(b) << "," << voices.BufferPeak(b);
+		info_output << endl;
 	}
+	voices.Clear(sound);  // only active ones touch sound
 	
+	snapshots.clear();
 	cars.clear();
+	mCars->Set(0);
+	remoteInputs.clear();
 	timer.Unload();
 	pause = false;
 }
@@ -615,6 +1032,13 @@ CAR* GAME::LoadCar(const string & pathCar, const string & carname, const MATHVEC
 				   const QUATERNION<float> & start_orientation, bool islocal, bool isai,
 				   bool isRemote, int idCar)
 {
+	WaitCarSounds();
+	isai = isai || (aiFrom >= 0 && idCar >= aiFrom);
+	if (isai && idCar >= 0)
+	{	if (idCar >= (int)aiCars.size())
+			aiCars.resize(idCar + 1, 0);
+		aiCars[idCar] = 1;
+	}
 	CONFIGFILE carconf;
 	if (!carconf.Load(pathCar))
 		return NULL;
@@ -654,10 +1078,29 @@ CAR* GAME::LoadCar(const string & pathCar, const string & carname, const MATHVEC
 	return &cars.back();
 }
 
+std::string GAME::TrackKey(const string & trackname) const
+{
+	return (settings->game.track_user ? PATHMANAGER::TracksUser() : PATHMANAGER::Tracks()) + "/" + trackname
+		+ (settings->game.trackreverse ? "|rev" : "|");
+}
+
 bool GAME::LoadTrack(const string & trackname)
 {
 	LoadingScreen(0.0,1.0);
 
+	//  same track still loaded, only collision
+	string key = TrackKey(trackname);
+	if (track.Loaded() && key == trackResident)
+	{
+		info_output << "Track resident, skipping load: " << trackname << endl;
+		collision.SetTrack(&track);
+		return true;
+	}
+	trackResident.clear();
+	patchIndex.Clear();
+	if (track.Loaded())
+		track.Unload();
+
 	//load the track
 	if (!track.DeferredLoad(
 		(settings->game.track_user ? PATHMANAGER::TracksUser() : PATHMANAGER::Tracks()) + "/" + trackname,
@@ -690,6 +1133,14 @@ bool GAME::LoadTrack(const string & trackname)
 	collision.SetTrack(&track);
 	collision.DebugPrint(info_output);
 
+	//  road patches grid, bezier roads only, nothing else queries it yet
+	if (patchBench > 0)
+	{	patchIndex.Build(track.GetRoadList());
+		patchIndex.Bench(patchBench, info_output);
+	}
+
+	trackResident = key;
+
 	return true;
 }
 
@@ -740,6 +1191,8 @@ void GAME::ProcessNewSettings()
 		carcontrols_local.first->SetAutoShift(settings->autoshift);
 		carcontrols_local.first->SetAutoRear(settings->autorear);
 		//carcontrols_local.first->SetAutoClutch(settings->rear_inv);
+
+		UpdateInputCfg();
 	}
 	sound.SetMasterVolume(settings->vol_master);
 }
@@ -754,117 +1207,63 @@ void GAME::LoadingScreen(float progress, float max)
 
 void GAME::UpdateForceFeedback(float dt)
 {
-#ifdef ENABLE_FORCE_FEEDBACK
+	if (!ffThread.Running())
+		return;
+	if (pause && dt == 0)
+	{	ffThread.Set(0.0);  // center
+		return;
+	}
 	if (carcontrols_local.first)
 	{
-		//static ofstream file("ff_output.txt");
-		ff_update_time += dt;
-		const double ffdt = 0.02;
-		if (ff_update_time >= ffdt )
-		{
-			ff_update_time = 0.0;
-			double feedback = -carcontrols_local.first->GetFeedback();
-
-			feedback = settings->ff_gain * feedback / 100.0;
-			if (settings->ff_invert) feedback = -feedback;
-
-			if (feedback > 1.0)
-				feedback = 1.0;
-			if (feedback < -1.0)
-				feedback = -1.0;
-			//feedback += 0.5;
-			/*
-			static double motion_frequency = 0.1;
-			static double motion_amplitude = 4.0;
-			static double spring_strength = 1.0;
-			*/
-			//double center = sin( timefactor * 2 * M_PI * motion_frequency ) * motion_amplitude;
-			double force = feedback;
-
-			//cout << "ff_update_time: " << ff_update_time << " force: " << force << endl;
-			forcefeedback->update(force, &feedback, ffdt, error_output);
-		}
-	}
+		double feedback = -carcontrols_local.first->GetFeedback();
 
-	if (pause && dt == 0)
-	{
-		double pos=0;
-		forcefeedback->update(0, &pos, 0.02, error_output);
+		feedback = settings->ff_gain * feedback / 100.0;
+		if (settings->ff_invert) feedback = -feedback;
+
+		if (feedback > 1.0)
+			feedback = 1.0;
+		if (feedback < -1.0)
+			feedback = -1.0;
+		//  sent to device by ffThread
+		ffThread.Set(feedback);
 	}
-#endif
 }
 
-void GAME::UpdateDriftScore(CAR & car, double dt)
+///  drift score for all cars in one pass
+void GAME::UpdateDriftScores(double dt)
 {
-	bool is_drifting = false;
-	bool spin_out = false;
+	drift.Resize((int)cars.size());
 
-	//make sure the car is not off track
-	int wheel_count = 0;
-	for (int i=0; i < 4; i++)
+	int i = 0;
+	for (list <CAR>::iterator it = cars.begin(); it != cars.end(); ++it, ++i)
 	{
-		if ( car.GetCurPatch ( WHEEL_POSITION(i) ) ) wheel_count++;
-	}
-
-	bool on_track = ( wheel_count > 1 );
-	int carId = 0;
+		//make sure the car is not off track
+		int wheel_count = 0;
+		for (int w=0; w < 4; w++)
+			if (it->GetCurPatch(WHEEL_POSITION(w)))  wheel_count++;
 
-	//car's direction on the horizontal plane
-	MATHVECTOR<float,3> car_orientation(1,0,0);
-	car.GetOrientation().RotateVector(car_orientation);
-	car_orientation[2] = 0;
-
-	//car's velocity on the horizontal plane
-	MATHVECTOR<float,3> car_velocity = car.GetVelocity();
-	car_velocity[2] = 0;
-	float car_speed = car_velocity.Magnitude();
-
-	//angle between car's direction and velocity
-	float car_angle = 0;
-	float mag = car_orientation.Magnitude() * car_velocity.Magnitude();
-	if (mag > 0.001)
-	{
-		float dotprod = car_orientation.dot ( car_velocity )/mag;
-		if (dotprod > 1.0)
-			dotprod = 1.0;
-		if (dotprod < -1.0)
-			dotprod = -1.0;
-		car_angle = acos(dotprod);
+		drift.Set(i, it->GetOrientation(), it->GetVelocity(), wheel_count > 1, timer.GetIsDrifting(i));
 	}
+	drift.Compute();
 
-	assert(car_angle == car_angle); //assert that car_angle isn't NAN
-
-	if ( on_track )
+	for (i = 0; i < (int)cars.size(); ++i)
 	{
-		//velocity must be above 10 m/s
-		if ( car_speed > 10 )
+		bool is_drifting = drift.Drifting(i);
+
+		//calculate score
+		if (is_drifting)
 		{
-			//drift starts when the angle > 0.2 (around 11.5 degrees)
-			//drift ends when the angle < 0.1 (aournd 5.7 degrees)
-			float angle_threshold(0.2);
-			if ( timer.GetIsDrifting(carId) ) angle_threshold = 0.1;
+			float car_speed = drift.Speed(i);
+			//base score is the drift distance
+			timer.IncrementThisDriftScore(i, dt * car_speed);
 
-			is_drifting = ( car_angle > angle_threshold && car_angle <= M_PI/2.0 );
-			spin_out = ( car_angle > M_PI/2.0 );
+			//bonus score calculation is now done in TIMER
+			timer.UpdateMaxDriftAngleSpeed(i, drift.Angle(i), car_speed);
 		}
-	}
-
-	//calculate score
-	if ( is_drifting )
-	{
-		//base score is the drift distance
-		timer.IncrementThisDriftScore(carId, dt * car_speed);
-
-		//bonus score calculation is now done in TIMER
-		timer.UpdateMaxDriftAngleSpeed(carId, car_angle, car_speed);
 
-		//cout << timer.GetDriftScore(carId) << " + " << timer.GetThisDriftScore(carId) << endl;
+		if (settings->multi_thr != 1)
+			timer.SetIsDrifting(i, is_drifting, drift.OnTrack(i) && !drift.SpinOut(i));
 	}
-
-	if (settings->multi_thr != 1)
-		timer.SetIsDrifting(carId, is_drifting, on_track && !spin_out);
-
-	//cout << is_drifting << ", " << on_track << ", " << car_angle << endl;
 }
 
 
@@ -960,6 +1359,10 @@ bool GAME::ParseArguments(list <string> & args)
 		sound.DisableAllSound();
 	arghelp["-nosound"] = "Disable all sound.";
 
+	if (argmap.find("-sound-lazy") != argmap.end())
+		soundLazy = true;
+	arghelp["-sound-lazy"] = "Load car sounds when the first car loads, not in background at start.";
+
 	if (argmap.find("-benchmark") != argmap.end())
 	{
 		info_output << "Entering benchmark mode." << endl;
@@ -967,6 +1370,137 @@ bool GAME::ParseArguments(list <string> & args)
 	}
 	arghelp["-benchmark"] = "Run in benchmark mode.";
 
+	if (!argmap["-benchscript"].empty())
+	{
+		bench.reset(new BENCHMARK());
+		if (bench->LoadScript(argmap["-benchscript"], error_output) && bench->Configure(settings, error_output))
+		{
+			settingsKeep = true;
+			benchReport = !argmap["-benchreport"].empty() ? argmap["-benchreport"]
+				: PATHMANAGER::UserConfigDir() + "/benchmark.json";
+			info_output << "Benchmark script: " << argmap["-benchscript"] << ", " << bench->frames << " frames" << endl;
+		}else
+		{	bench.reset();
+			continue_game = false;
+		}
+	}
+	arghelp["-benchscript FILE"] = "Run scripted benchmark: fixed track, cars and commands, then exit.";
+	arghelp["-benchreport FILE"] = "Where to write the benchmark report (json).";
+
+	//  farm workers are forked after this, they can't share the writer thread or segment
+	bool farmArg = !argmap["-farm"].empty();
+	if (farmArg && (!argmap["-cmdrecord"].empty() || !argmap["-shm"].empty()))
+	{	error_output << "-farm can't be used with -cmdrecord or -shm" << endl;
+		continue_game = false;
+	}
+	else if (!argmap["-cmdrecord"].empty())
+	{
+		if (cmdLog.Open(argmap["-cmdrecord"], error_output))
+			info_output << "Recording remote commands to: " << argmap["-cmdrecord"] << endl;
+	}
+	if (argmap.find("-remote-oneway") != argmap.end())
+		remoteOneWay = true;
+	arghelp["-remote-oneway"] = "Send no replies to remote commands (DEALER clients).";
+	if (argmap.find("-remote-admin") != argmap.end())
+		remote.admin = true;
+	arghelp["-remote-admin"] = "Allow restore, tire and surface commands from any client and shm.";
+
+	if (!argmap["-sound-voices"].empty())
+		voices.budget = max(1, atoi(argmap["-sound-voices"].c_str()));
+	arghelp["-sound-voices N"] = "Max car sound sources mixed, nearest cars first (default 48).";
+
+	if (argmap.find("-ff-null") != argmap.end())
+		ffNull = true;
+	arghelp["-ff-null"] = "Force feedback thread with a null device (no hardware), for testing.";
+
+	if (!argmap["-metrics-port"].empty())
+		metricsPort = max(0, atoi(argmap["-metrics-port"].c_str()));
+	arghelp["-metrics-port N"] = "Serve runtime metrics (prometheus text) on 127.0.0.1:N, + worker index in farm.";
+
+	if (!argmap["-patchbench"].empty())
+		patchBench = max(0, atoi(argmap["-patchbench"].c_str()));
+	arghelp["-patchbench N"] = "Time N road patch lookups (linear, grid, cached) after each track load.";
+
+	if (!argmap["-startup-threads"].empty())
+		startupThreads = max(1, atoi(argmap["-startup-threads"].c_str()));
+	arghelp["-startup-threads N"] = "Run independent startup stages on N threads (default 4, 1 in order).";
+	if (!argmap["-startupreport"].empty())
+		startupReport = argmap["-startupreport"];
+	arghelp["-startupreport FILE"] = "Write startup stage times to FILE (json).";
+
+	if (!argmap["-physics-threads"].empty())
+		physicsThreads = max(1, atoi(argmap["-physics-threads"].c_str()));
+	arghelp["-physics-threads N"] = "Solve physics islands and ai drivers on N threads (default 1).";
+
+	if (!argmap["-ai"].empty())
+		aiFrom = max(0, atoi(argmap["-ai"].c_str()));
+	arghelp["-ai N"] = "Computer drives cars from the Nth on (0 all), e.g. -ai 1 with one player.";
+	if (!argmap["-ai-pertick"].empty())
+		ai.carsPerTick = (unsigned int)max(0, atoi(argmap["-ai-pertick"].c_str()));
+	arghelp["-ai-pertick N"] = "Ai cars updated per tick, round robin, others keep their last input (default 0 all).";
+
+	if (logging::asynclog* log = logging::asynclog::Get())
+	{
+		string lv = argmap["-loglevel"];
+		if (lv == "error")  log->SetLevel(logging::LOG_ERROR);  else
+		if (lv == "info")   log->SetLevel(logging::LOG_INFO);
+		if (!argmap["-lograte"].empty())
+			log->SetRate(max(0, atoi(argmap["-lograte"].c_str())));
+	}
+	arghelp["-loglevel L"] = "Least log level written: info (default) or error.";
+	arghelp["-lograte N"] = "Max info lines per second from one thread, 0 unlimited (default).";
+
+	if (!argmap["-remote-queue"].empty())
+		remote.queueMax = max(1, atoi(argmap["-remote-queue"].c_str()));
+	arghelp["-remote-queue N"] = "Max queued remote commands per client, oldest dropped.";
+
+	if (!argmap["-remote-pertick"].empty())
+		remotePerTick = max(1, atoi(argmap["-remote-pertick"].c_str()));
+	arghelp["-remote-pertick N"] = "Max remote commands applied per client each tick.";
+
+	if (!argmap["-remote-idle"].empty())
+		remote.idleSec = (unsigned int)max(0, atoi(argmap["-remote-idle"].c_str()));
+	arghelp["-remote-idle SEC"] = "Close remote sessions silent this long and free their cars (default 60, 0 never).";
+
+	if (!farmArg && !argmap["-shm"].empty())
+	{
+		if (shmCtl.Open(argmap["-shm"], error_output))
+			info_output << "Shared memory control: " << argmap["-shm"] << endl;
+	}
+	if (!argmap["-farm"].empty())
+	{
+		farmWorkers = atoi(argmap["-farm"].c_str());
+		farmSpecs = argmap["-farmspecs"];
+		farmOut = !argmap["-farmout"].empty() ? argmap["-farmout"] : PATHMANAGER::UserConfigDir();
+		if (farmSpecs.empty())
+		{	error_output << "-farm needs -farmspecs FILE" << endl;
+			continue_game = false;
+		}
+	}
+	arghelp["-farm N"] = "Sim farm: fork N workers that run the benchmark scripts listed in -farmspecs.";
+	arghelp["-farmspecs FILE"] = "Sim farm run list, one benchmark script path per line.";
+	arghelp["-farmout DIR"] = "Sim farm reports and farm_results.txt.";
+
+	if (argmap.find("-notrackkeep") != argmap.end())
+		trackKeep = false;
+	arghelp["-notrackkeep"] = "Always reload the track on new game.";
+
+	arghelp["-shm NAME"] = "Shared memory input ring and car telemetry for local agents.";
+
+	arghelp["-cmdrecord FILE"] = "Record applied remote commands to a binary log.";
+
+	if (!argmap["-cmdreplay"].empty())
+	{
+		cmdReplay.reset(new CMD_LOG_READER());
+		if (cmdReplay->Load(argmap["-cmdreplay"], error_output))
+			info_output << "Replaying remote commands from: " << argmap["-cmdreplay"] << endl;
+		else
+		{	cmdReplay.reset();
+			continue_game = false;
+		}
+	}
+	arghelp["-cmdreplay FILE"] = "Replay a recorded command log at its frames, live commands are ignored.";
+
 
 	arghelp["-help"] = "Display command-line help.";
 	if (argmap.find("-help") != argmap.end() || argmap.find("-h") != argmap.end() || argmap.find("--help") != argmap.end() || argmap.find("-?") != argmap.end())
@@ -996,6 +1530,22 @@ void GAME::UpdateTimer()
 	if (app->iLoad1stFrames == -2)  // ended loading
 		timer.Tick(TickPeriod());
 	//timer.DebugPrint(info_output);
+
+	//  new finished laps to records store (benchmark and farm runs, sized only then)
+	int i = 0;
+	for (list <CAR>::iterator it = cars.begin(); it != cars.end() && i < (int)recLaps.size(); ++it, ++i)
+	{
+		int lap = timer.GetCurrentLap(i);
+		if (lap <= recLaps[i])
+			continue;
+		recLaps[i] = lap;
+		float t = timer.GetLastLap(i);
+		if (t > 0.f)
+		{	records.Append(settings->game.track, settings->game.trackreverse, it->GetCarType(),
+				settings->game.sim_mode, t);
+			bench->Lap(i, t);
+		}
+	}
 }
 
 
@@ -1006,46 +1556,169 @@ float GAME::GetSteerRange() const
 	range *= settings->steer_range[track.asphalt];
 	return range;
 }
-void* GAME::custom_duty(void){
-    void *nothing;
-    int dirty=1;
-    zmq::context_t context (1);
-    zmq::socket_t socket (context, ZMQ_REP);
-    socket.bind ("tcp://*:5555");
-    zmq::message_t request;
-    while (true) {
-        if(!cars.empty()){
-            // Wait for next request from client
-            socket.recv (&request);
-            std::cout << "Received Hello" << std::endl;
-            std::string rpl = std::string(static_cast<char*>(request.data()), request.size());
-            // Send reply back to client
-            zmq::message_t reply (2);
-            memcpy ((void *) reply.data (), "OK", 2);
-            socket.send (reply);
-            for (list <CAR>::iterator car = cars.begin(); car != cars.end(); ++car)
-            {
-                //car->dynamics.boostVal = settings->game.boost_max;
-                //car->dynamics.doBoost = 1;
-                //car->SetTCS(true);
-                //car->SetABS(true);
-                if(!rpl.compare("brake100")){
-                    car->dynamics.SetBrake(100);                
-                }else if(!rpl.compare("brake0")){
-                    car->dynamics.SetBrake(0);                
-                }
-                else if(!rpl.compare("boostmax")){
-                    car->dynamics.boostFuel = settings->game.boost_max;               
-                }
-                else if(!rpl.compare("boost2")){
-                    car->dynamics.boostFuel = car->dynamics.boostFuel<settings->game.boost_max?car->dynamics.boostFuel+2:settings->game.boost_max;               
-                }
-                break;
-            }
-        }
-        sleep(1);    
-    }
-    return nothing;
+///  apply queued remote and scripted commands, at start of a physics frame
+void GAME::ProcessRemoteCmds()
+{
+	remote.Drain(remoteCmds, remotePerTick);
+	size_t local = remoteCmds.size();
+	shmCtl.GetCmds(remoteCmds);
+	if (remoteCmds.size() > local)  // no session, same checks as one without cars
+		remote.CheckLocal(remoteCmds, local);
+	if (cmdReplay.get())
+	{	remoteCmds.clear();  // live commands ignored while replaying
+		cmdReplay->GetCmds(race_frame, remoteCmds);
+	}
+	if (bench.get())
+		bench->GetCmds(race_frame, remoteCmds);
+
+	remoteApplied = 0;
+	mCmdsDrained->Add(remoteCmds.size());
+	unsigned long long now = remoteCmds.empty() ? 0 : GetTimeUs();
+	for (size_t i = 0; i < remoteCmds.size(); ++i)
+	{
+		const REMOTE_CMD& cmd = remoteCmds[i];
+		unsigned int f = race_frame;  // restore rewinds it, log the frame it came in
+		if (ApplyRemoteCmd(cmd))
+		{	++remoteApplied;
+			if (!cmdLog.Record(f, cmd))
+				error_output << "Command log: car id " << cmd.car << " too big, not logged" << endl;
+		}
+		if (cmd.recvUs > 0)
+		{	remoteLatency.Add(now > cmd.recvUs ? now - cmd.recvUs : 0);
+			latencyNew = true;
+		}
+	}
+	mCmdsApplied->Add(remoteApplied);
+}
+
+//  server and scrape threads read copies
+void GAME::PublishHistograms(unsigned long long now)
+{
+	histPubUs = now + 100000;
+	mTickUs->Set(tickUs);
+	if (latencyNew)
+	{	remote.PublishLatency(remoteLatency);
+		mRemoteLatency->Set(remoteLatency);
+		latencyNew = false;
+	}
+}
+
+bool GAME::ApplyRemoteCmd(const REMOTE_CMD& cmd)
+{
+	if (cmd.type == REMOTE_CMD::SNAPSHOT)
+		return SaveSnapshot((int)cmd.value);
+	if (cmd.type == REMOTE_CMD::RESTORE)
+		return RestoreSnapshot((int)cmd.value);
+	if (cmd.type == REMOTE_CMD::TIRE)
+		return PatchTire(cmd.car, cmd.param, cmd.value);
+	if (cmd.type == REMOTE_CMD::SURFACE)
+		return PatchSurface(cmd.car, cmd.param, cmd.value);
+
+	CAR* car = NULL;
+	int id = RemoteCmdCar(cmd);
+	for (list <CAR>::iterator it = cars.begin(); it != cars.end() && !car; ++it)
+		if (it->id == id)
+			car = &*it;
+	if (!car)
+		return false;
+
+	CARDYNAMICS& cd = car->dynamics;
+	switch (cmd.type)
+	{
+	case REMOTE_CMD::BOOST_MAX:
+		cd.boostFuel = settings->game.boost_max;
+		return true;
+	case REMOTE_CMD::BOOST_ADD:
+		cd.boostFuel = cd.boostFuel + cmd.value < settings->game.boost_max ? cd.boostFuel + cmd.value : settings->game.boost_max;
+		return true;
+	default:
+		return car->id < (int)remoteInputs.size() && remoteInputs[car->id].Set(cmd);
+	}
+}
+
+///  tire and surface params, changed in place at frame start
+//  cars and surfaces keep their pointers, only this tire is recalculated
+//-----------------------------------------------------------
+bool GAME::PatchTire(int id, int param, float value)
+{
+	if (id < 0 || id >= (int)tires.size())
+		return false;
+	CARTIRE& t = tires[id];
+	if (param >= 0 && param < 15)          t.lateral[param] = value;
+	else if (param >= 100 && param < 111)  t.longitudinal[param-100] = value;
+	else if (param >= 200 && param < 218)  t.aligning[param-200] = value;
+	else  return false;
+	t.CalculateSigmaHatAlphaHat();
+	return true;
+}
+
+bool GAME::PatchSurface(int id, int param, float value)
+{
+	if (id < 0 || id >= (int)surfaces.size())
+		return false;
+	TRACKSURFACE& su = surfaces[id];
+	switch (param)
+	{
+	case SP_FRICTION:    su.friction = value;  break;
+	case SP_FRICTION_X:  su.frictionX = value;  break;
+	case SP_FRICTION_Y:  su.frictionY = value;  break;
+	case SP_ROLL_RESIST: su.rollingResist = value;  break;
+	case SP_ROLL_DRAG:   su.rollingDrag = value;  break;
+	case SP_BUMP_WAVE:   su.bumpWaveLength = value;  break;
+	case SP_BUMP_AMP:    su.bumpAmplitude = value;  break;
+	case SP_BUMP_WAVE2:  su.bumpWaveLength2 = value;  break;
+	case SP_BUMP_AMP2:   su.bumpAmplitude2 = value;  break;
+	default:  return false;
+	}
+	return true;
+}
+
+///  snapshots
+//-----------------------------------------------------------
+bool GAME::SaveSnapshot(int slot)
+{
+	if (!track.Loaded() || cars.empty())
+		return false;
+	if (slot < 0 || slot >= SIM_SNAPSHOT::SLOTS)
+	{	error_output << "Snapshot slot " << slot << " not in 0.." << SIM_SNAPSHOT::SLOTS-1 << endl;
+		return false;
+	}
+	Ogre::Timer ti;
+	SIM_SNAPSHOT& s = snapshots[slot];
+	s.Save(collision.world, cars, timer, remoteInputs, race_frame);
+	info_output << "Snapshot " << slot << " at frame " << race_frame << ", " << s.Bytes() << " bytes, "
+		<< fToStr(ti.getMicroseconds() * 0.001f, 2,4) << " ms" << endl;
+	return true;
+}
+
+bool GAME::RestoreSnapshot(int slot)
+{
+	std::map<int, SIM_SNAPSHOT>::const_iterator it = snapshots.find(slot);
+	if (it == snapshots.end())
+		return false;
+	if (!it->second.Restore(collision.world, cars, timer, remoteInputs, race_frame))
+	{	error_output << "Snapshot " << slot << " doesn't match current cars or bodies" << endl;
+		return false;
+	}
+	return true;
+}
+
+
+///  remote command server thread
+///  car state for local agents, after each simulated frame
+void GAME::PublishTelemetry()
+{
+	if (!shmCtl.IsOpen())  return;
+	int slot = 0;
+	for (list <CAR>::iterator it = cars.begin(); it != cars.end(); ++it, ++slot)
+		shmCtl.Publish(race_frame, slot, *it);
+}
+
+void* GAME::custom_duty(void)
+{
+	remote.log = &info_output;
+	remote.Run(("tcp://*:" + toStr(remotePort)).c_str(), remoteOneWay);
+	return NULL;
 }
 void* GAME::custom_duty_helper(void *context){
         return ((GAME *)context)->custom_duty();
@@ -18,9 +18,28 @@
 
 #include "timer.h"
 #include "forcefeedback.h"
+#include "ff_thread.h"
+#include "voice_manager.h"
+#include "remote_cmd.h"
+#include "remote_server.h"
+#include "shm_transport.h"
+#include "drift_batch.h"
+#include "sim_farm.h"
+#include "sim_snapshot.h"
+#include "patch_index.h"
+#include "records_store.h"
+#include "worker_pool.h"
+#include "parallel_solver.h"
+#include "ai_driver.h"
+#include "benchmark.h"
+#include "cmd_log.h"
+#include "async_log.h"
+#include "startup_graph.h"
+#include "metrics.h"
 
 #include <OgreTimer.h>
 #include <boost/thread.hpp>
+#include <sstream>
 
 //patch start joseph:
 #include <unistd.h>
@@ -47,9 +66,29 @@ public:
 
 	void AdvanceGameLogic(double dt);
 	void UpdateCar(CAR & car, double dt);
-	void UpdateDriftScore(CAR & car, double dt);
-	void UpdateCarInputs(CAR & car);
+	void UpdateDriftScores(double dt);
+	void UpdateCarInputs();  // all cars
+
+	///  input stage, settings that stay during a race are taken once
+	//  (ProcessNewSettings, race start); per player ones (one axis) are read live
+	//  the loop over cars is specialised on ai and perf test, picked with them
+	struct INPUT_CFG
+	{	float sss_eff, sss_velf;
+		bool ai, perfTest;
+		INPUT_CFG() : sss_eff(0.f), sss_velf(0.f), ai(false), perfTest(false)  {  }
+	} inputCfg;
+	void UpdateInputCfg();
+	typedef void (GAME::*InputFn)(bool forceBrake);
+	InputFn inputFn;
+	template <bool Ai, bool PerfTest> void CarInputs(bool forceBrake);
+	std::vector<float> carInputs;  // reused each car
 	void UpdateTimer();
+	RECORDS_STORE records;  // lap times, binary, appended
+	std::vector<int> recLaps;  // per car, laps already stored
+	void ProcessRemoteCmds();
+	bool ApplyRemoteCmd(const REMOTE_CMD& cmd);
+	bool PatchTire(int id, int param, float value);
+	bool PatchSurface(int id, int param, float value);
 
 	//bool NewGame(bool playreplay=false, bool opponents=false, int num_laps=0);
 	
@@ -60,8 +99,26 @@ public:
 	bool NewGameDoLoadMisc(float pre_time);
 	
 	
-	void LeaveGame();
+	void LeaveGame(bool keepTrack = false);
 	bool LoadTrack(const std::string & trackname);
+
+	///  track kept loaded between games, if the next one is the same
+	std::string trackResident;  // key of loaded track, empty if none
+	std::string TrackKey(const std::string & trackname) const;
+	bool trackKeep;  // off with -notrackkeep
+	PATCH_INDEX patchIndex;  // road patches by position, with track, only for -patchbench
+	int patchBench;  // -patchbench N lookups after track load
+
+	///  threads for work inside a tick, physics islands and ai  (-physics-threads)
+	WORKER_POOL workers;
+	int physicsThreads;
+	std::auto_ptr<PARALLEL_SOLVER> physicsSolver;  // set on collision.world
+
+	///  computer drivers, cars loaded as ai or ids from -ai N
+	AI_DRIVERS ai;
+	int aiFrom;  // -1 none
+	std::vector<char> aiCars;  // per car id
+	void LoadAiPath();
 	CAR* LoadCar(const std::string & pathCar, const std::string & carname, const MATHVECTOR<float,3> & start_position,
 		const QUATERNION<float> & start_orientation, bool islocal, bool isai,
 		bool isRemote/*=false*/, int idCar);
@@ -75,6 +132,11 @@ public:
 	void LoadingScreen(float progress, float max);
 	void ProcessNewSettings();
 	void UpdateForceFeedback(float dt);
+
+	///  simulation snapshots, for rollouts  (also remote: snap N, restore N)
+	std::map<int, SIM_SNAPSHOT> snapshots;
+	bool SaveSnapshot(int slot);
+	bool RestoreSnapshot(int slot);
 	float GetSteerRange() const;  //inline?
 
 //  vars
@@ -82,6 +144,7 @@ public:
 	std::ostream & info_output;
 	std::ostream & error_output;
 	unsigned int frame; ///< physics frame counter
+	unsigned int race_frame; ///< simulated frames since race start, for scripts
 	unsigned int displayframe; ///< display frame counter
 	double clocktime; ///< elapsed wall clock time
 	double target_time;
@@ -104,10 +167,20 @@ public:
 
 	SOUND sound;
 	SOUND_LIB sound_lib;
+	VOICE_MANAGER voices;  // which car sounds are mixed
 	///  hud 2d sounds  //)
 	SOUNDSOURCE snd_chk, snd_chkwr,  snd_lap, snd_lapbest,  snd_stage, snd_win[3], snd_fail;
 	void UpdHudSndVol();
 
+	///  car samples load on a thread while startup goes on, done before first car
+	boost::thread soundLoader;
+	bool soundLazy;  // -sound-lazy: no thread, load at first car
+	bool soundCarLoaded, soundCarOk;
+	float soundCarMs;
+	std::ostringstream soundCarLog;
+	void LoadCarSounds();
+	void WaitCarSounds();
+
 
 	SETTINGS* settings;
 	TRACK track;
@@ -132,20 +205,74 @@ public:
 	std::map <std::string, int> suspS_map,suspD_map;  // name to susp id
 	bool LoadSusp();
 	
-#ifdef ENABLE_FORCE_FEEDBACK
-	std::auto_ptr <FORCEFEEDBACK> forcefeedback;
-	double ff_update_time;
-#endif
+	///  force feedback, device I/O off the game thread
+	FF_THREAD ffThread;
+	bool ffNull;  // -ff-null
+
+	///  startup stages, independent ones at once  (-startup-threads, -startupreport)
+	STARTUP_GRAPH startup;  // main records its stages here too
+	int startupThreads;
+	std::string startupReport;
+	void StartMetrics();
+	void StartRecords();
+	void StartCarsim();  // tires, susp
+	void StartPhysics();
+	void StartOptions();
+	void StartForceFeedback();
 	void* custom_duty(void);
     static void *custom_duty_helper(void *context);
+
+	///  remote commands, queued per client by custom_duty, applied at tick start
+	bool remoteOneWay;  // no replies sent
+	REMOTE_SERVER remote;
+	unsigned int remotePerTick;  // max commands per client each tick
+	int remotePort;  // 5555, + worker index in farm
+	SHM_TRANSPORT shmCtl;  // local agents  (-shm)
+	void PublishTelemetry();
+	std::vector<REMOTE_CMD> remoteCmds;  // drained for this tick
+	std::vector<REMOTE_INPUT> remoteInputs;  // per car id
+	unsigned int remoteApplied;  // this tick
+	HISTOGRAM_US remoteLatency;  // receive to applied, network commands
+
+	///  applied commands log  (-cmdrecord),  replay instead of remote input  (-cmdreplay)
+	CMD_LOG_WRITER cmdLog;
+	std::auto_ptr<CMD_LOG_READER> cmdReplay;
+
+	///  runtime metrics, scraped from 127.0.0.1  (-metrics-port)
+	METRICS metrics;
+	int metricsPort;  // 0 off, + worker index in farm
+	METRIC_COUNTER *mTicks, *mTicksDropped, *mCmdsDrained, *mCmdsApplied;
+	METRIC_GAUGE *mLoadTrackMs, *mReloadSimMs, *mInitSoundMs, *mCars;
+	METRIC_HISTOGRAM *mTickUs, *mRemoteLatency;  // copies of tickUs, remoteLatency
+	HISTOGRAM_US tickUs;  // AdvanceGameLogic
+	//  copies are taken under a mutex, so at most every 100 ms, not each tick
+	unsigned long long histPubUs;
+	bool latencyNew;  // remoteLatency changed since last copy
+	void PublishHistograms(unsigned long long now);
+	void InitMetrics();
+
+	///  scripted benchmark  (-benchscript)
+	std::auto_ptr<BENCHMARK> bench;
+	std::string benchReport;
+	bool settingsKeep;  // settings changed for a benchmark, not saved at exit
+	void BenchDone();
+
+	///  sim farm  (-farm N), worker runs benchmarks handed out by master
+	SIM_FARM farm;
+	int farmWorkers, farmRunId;
+	std::string farmSpecs, farmOut;
+	bool farmNewGame;
+	bool FarmNextRun();
 public:
 	COLLISION_WORLD collision;
 	
 	TIMER timer;
+	DRIFT_BATCH drift;  // all cars, state in timer
 
 public:
 	GAME(std::ostream & info_out, std::ostream & err_out, SETTINGS* pSettings);
 
-	void Start(std::list <std::string> & args);
-	void ReloadSimData();
+	bool Start(std::list <std::string> & args);  // false to exit
+	void ReloadSimData(bool force = false);  // only if sim_mode or track default tire changed, unless forced
+	std::string simDataMode, simSurfKey;  // loaded for: tires and susp, surfaces
 };
@@ -0,0 +1,61 @@
+#pragma once
+#include <string>
+#include <sstream>
+
+
+///  log2 histogram of times in us, fixed size, no allocation on Add
+//  bucket i holds values in [2^(i-1), 2^i), percentiles are bucket upper bounds
+class HISTOGRAM_US
+{
+public:
+	enum {  BUCKETS = 40  };
+
+	HISTOGRAM_US()  {  Reset();  }
+
+	void Reset()
+	{
+		for (int i = 0; i < BUCKETS; ++i)  bucket[i] = 0;
+		count = 0;  sum = 0;  maxUs = 0;
+	}
+
+	void Add(unsigned long long us)
+	{
+		int b = 0;
+		while (b < BUCKETS-1 && (1ull << b) <= us)  ++b;
+		++bucket[b];  ++count;  sum += us;
+		if (us > maxUs)  maxUs = us;
+	}
+
+	unsigned long long Count() const  {  return count;  }
+	unsigned long long Max() const  {  return maxUs;  }
+	unsigned long long Sum() const  {  return sum;  }
+	double Mean() const  {  return count ? double(sum) / count : 0.0;  }
+	//  values in bucket b are below 2^b
+	unsigned long long Bucket(int b) const  {  return bucket[b];  }
+
+	//  p in 0..1
+	unsigned long long Percentile(double p) const
+	{
+		if (count == 0)  return 0;
+		unsigned long long want = (unsigned long long)(p * count + 0.5), n = 0;
+		if (want < 1)  want = 1;
+		for (int b = 0; b < BUCKETS; ++b)
+		{	n += bucket[b];
+			if (n >= want)
+				return b == 0 ? 0 : (1ull << b) - 1;
+		}
+		return maxUs;
+	}
+
+	std::string Summary() const
+	{
+		std::ostringstream s;
+		s << "n " << count << " mean " << (unsigned long long)Mean()
+		  << " p50 " << Percentile(0.5) << " p99 " << Percentile(0.99) << " max " << maxUs << " us";
+		return s.str();
+	}
+
+private:
+	unsigned long long bucket[BUCKETS];
+	unsigned long long count, sum, maxUs;
+};
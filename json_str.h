@@ -0,0 +1,23 @@
+#pragma once
+#include <string>
+#include <cstdio>
+
+
+///  quoted json string, for names and paths written into reports
+inline std::string JsonStr(const std::string& s)
+{
+	std::string o = "\"";
+	for (size_t i = 0; i < s.length(); ++i)
+	{
+		unsigned char c = s[i];
+		if (c == '"' || c == '\\')
+		{	o += '\\';  o += c;  }
+		else if (c < 0x20)
+		{	char buf[8];
+			sprintf(buf, "\\u%04x", c);
+			o += buf;
+		}else
+			o += c;
+	}
+	return o + "\"";
+}
@@ -5,8 +5,10 @@
 #include "CGame.h"
 #include "../vdrift/game.h"
 #include "../vdrift/logging.h"
+#include "../vdrift/async_log.h"
 #include "../vdrift/pathmanager.h"
 #include "../vdrift/settings.h"
+#include "../vdrift/timeus.h"
 #include "../network/enet-wrapper.hpp"
 
 #include <string>
@@ -44,6 +46,8 @@ void LoadDefaultSet(SETTINGS* settings, std::string setFile)
 {
 	setlocale(LC_NUMERIC, "C");
 
+	//  startup stage times, for the report GAME::Start writes
+	unsigned long long tPaths = GetTimeUs();
 	PATHMANAGER::Init(std::cout, std::cerr);
 
 
@@ -74,8 +78,10 @@ void LoadDefaultSet(SETTINGS* settings, std::string setFile)
 	// Set up logging arrangement
 	logging::splitterstreambuf infosplitter(std::cout, logfile);	std::ostream infosplitterstream(&infosplitter);
 	logging::splitterstreambuf errorsplitter(std::cerr, logfile);	std::ostream errorsplitterstream(&errorsplitter);
-	logging::logstreambuf infolog("INFO: ", infosplitterstream);	//logstreambuf infolog("INFO: ", logfile);
-	logging::logstreambuf errorlog("ERROR: ", errorsplitterstream);
+	//  lines are queued, console and file writes happen on the log thread
+	logging::asynclog asynclog;
+	logging::asynclogbuf infolog("INFO: ", logging::LOG_INFO, infosplitterstream, asynclog);
+	logging::asynclogbuf errorlog("ERROR: ", logging::LOG_ERROR, errorsplitterstream, asynclog);
 
 	// Primary logging ostreams
 	std::ostream info_output(&infolog);
@@ -84,8 +90,10 @@ void LoadDefaultSet(SETTINGS* settings, std::string setFile)
 	// HACK: We initialize paths a second time now that we have the output streams
 	PATHMANAGER::Init(info_output, error_output, false);  // false - same paths, dont log
 
+	unsigned long long tEnet = GetTimeUs();
 	// Initialize networking
 	net::ENetContainer enet;
+	unsigned long long tSettings = GetTimeUs();
 
 
 	///  Load Settings
@@ -109,6 +117,7 @@ void LoadDefaultSet(SETTINGS* settings, std::string setFile)
 	
 	// HACK: we initialize paths a second time now that we have the output streams
 	PATHMANAGER::Init(info_output, error_output);
+	unsigned long long tGame = GetTimeUs();
 
 	
 	//  helper for testing networked game on 1 computer
@@ -132,16 +141,32 @@ void LoadDefaultSet(SETTINGS* settings, std::string setFile)
 	///  Game start
 	//----------------------------------------------------------------
 	GAME* pGame = new GAME(info_output, error_output, settings);
-	std::list <std::string> args;//(argv, argv + argc);
-	pGame->Start(args);  //game.End();
+	pGame->startup.Record("paths_log", tPaths, tEnet);
+	pGame->startup.Record("enet", tEnet, tSettings);
+	pGame->startup.Record("settings", tSettings, tGame);
+	pGame->startup.Record("game", tGame, GetTimeUs());
+	#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+	std::list <std::string> args;
+	#else
+	std::list <std::string> args(argv + 1, argv + argc);
+	#endif
+	if (!pGame->Start(args))  //game.End();
+	{	//  help, tests, farm master done
+		delete pGame;
+		delete settings;
+		std::cout.rdbuf(oldCout);
+		std::cerr.rdbuf(oldCerr);
+		return 0;
+	}
 
 	App* pApp = new App(settings, pGame);
 	pGame->app = pApp;
 
+	pthread_t t1;
+	bool remoteThread = false;
 	try
 	{
-        pthread_t t1;
-        pthread_create( &t1, NULL, &GAME::custom_duty_helper,pGame);
+        remoteThread = pthread_create( &t1, NULL, &GAME::custom_duty_helper,pGame) == 0;
 		#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
 			pApp->Run( settings->ogre_dialog || lpCmdLine[0]!=0 );  //Release change-
 		#else
@@ -157,6 +182,11 @@ void LoadDefaultSet(SETTINGS* settings, std::string setFile)
 		#endif
 	}
 
+	//  it logs and uses the game, stop it before both go
+	if (remoteThread)
+	{	pGame->remote.Stop();
+		pthread_join(t1, NULL);
+	}
 	info_output << "Exiting" << std::endl;
 	delete pApp;
 	delete pGame;
@@ -0,0 +1,174 @@
+#include "pch.h"
+#include "metrics.h"
+#include <sstream>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#endif
+using namespace std;
+
+
+METRICS::METRICS()
+	: sock(-1), quit(false), error_output(NULL)
+{	}
+
+METRICS::~METRICS()
+{
+	Stop();
+	for (size_t i = 0; i < entries.size(); ++i)
+	{	delete entries[i].c;
+		delete entries[i].g;
+		delete entries[i].h;
+	}
+}
+
+METRIC_COUNTER* METRICS::Counter(const string& name, const string& help)
+{
+	ENTRY e;  e.name = name;  e.help = help;  e.type = COUNTER;
+	e.c = new METRIC_COUNTER();  e.g = NULL;  e.h = NULL;
+	boost::mutex::scoped_lock lock(mutex);
+	entries.push_back(e);
+	return e.c;
+}
+
+METRIC_GAUGE* METRICS::Gauge(const string& name, const string& help)
+{
+	ENTRY e;  e.name = name;  e.help = help;  e.type = GAUGE;
+	e.c = NULL;  e.g = new METRIC_GAUGE();  e.h = NULL;
+	boost::mutex::scoped_lock lock(mutex);
+	entries.push_back(e);
+	return e.g;
+}
+
+METRIC_HISTOGRAM* METRICS::Histogram(const string& name, const string& help)
+{
+	ENTRY e;  e.name = name;  e.help = help;  e.type = HISTOGRAM;
+	e.c = NULL;  e.g = NULL;  e.h = new METRIC_HISTOGRAM();
+	boost::mutex::scoped_lock lock(mutex);
+	entries.push_back(e);
+	return e.h;
+}
+
+string METRICS::Text() const
+{
+	ostringstream s;
+	boost::mutex::scoped_lock lock(mutex);
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		const ENTRY& e = entries[i];
+		s << "# HELP " << e.name << " " << e.help << "\n";
+		switch (e.type)
+		{
+		case COUNTER:
+			s << "# TYPE " << e.name << " counter\n" << e.name << " " << e.c->Get() << "\n";
+			break;
+		case GAUGE:
+			s << "# TYPE " << e.name << " gauge\n" << e.name << " " << e.g->Get() << "\n";
+			break;
+		case HISTOGRAM:
+		{	//  cumulative log2 buckets, last one is only +Inf
+			s << "# TYPE " << e.name << " histogram\n";
+			HISTOGRAM_US h = e.h->Get();
+			unsigned long long n = 0;
+			for (int b = 0; b < HISTOGRAM_US::BUCKETS-1; ++b)
+			{	n += h.Bucket(b);
+				s << e.name << "_bucket{le=\"" << (b == 0 ? 0 : (1ull << b) - 1) << "\"} " << n << "\n";
+			}
+			n += h.Bucket(HISTOGRAM_US::BUCKETS-1);
+			s << e.name << "_bucket{le=\"+Inf\"} " << n << "\n";
+			s << e.name << "_sum " << h.Sum() << "\n";
+			s << e.name << "_count " << n << "\n";
+		}	break;
+		}
+	}
+	return s.str();
+}
+
+
+///  scrape endpoint, plain http/1.0, any request path gets the text
+//-----------------------------------------------------------
+#ifdef _WIN32
+bool METRICS::Serve(int port, ostream& err)
+{
+	err << "Metrics: scrape endpoint not supported on Windows" << endl;
+	return false;
+}
+void METRICS::Stop()  {  }
+void METRICS::Run()  {  }
+#else
+
+bool METRICS::Serve(int port, ostream& err)
+{
+	Stop();
+	error_output = &err;
+	sock = socket(AF_INET, SOCK_STREAM, 0);
+	if (sock < 0)
+	{	err << "Metrics: can't create socket" << endl;
+		return false;
+	}
+	int on = 1;
+	setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);  // local only
+	if (bind(sock, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(sock, 8) < 0)
+	{	err << "Metrics: can't listen on 127.0.0.1:" << port << endl;
+		close(sock);  sock = -1;
+		return false;
+	}
+	quit = false;
+	thread = boost::thread(&METRICS::Run, this);
+	return true;
+}
+
+void METRICS::Stop()
+{
+	if (sock < 0)  return;
+	quit = true;
+	thread.join();
+	close(sock);
+	sock = -1;
+}
+
+void METRICS::Run()
+{
+	char req[1024];
+	while (!quit)
+	{
+		//  wake up to check quit
+		fd_set fds;  FD_ZERO(&fds);  FD_SET(sock, &fds);
+		timeval tv;  tv.tv_sec = 0;  tv.tv_usec = 200000;
+		if (select(sock+1, &fds, NULL, NULL, &tv) <= 0)
+			continue;
+		int c = accept(sock, NULL, NULL);
+		if (c < 0)
+			continue;
+
+		//  a scraper sends its request at once, don't wait on slow ones
+		timeval rt;  rt.tv_sec = 1;  rt.tv_usec = 0;
+		setsockopt(c, SOL_SOCKET, SO_RCVTIMEO, &rt, sizeof(rt));
+		setsockopt(c, SOL_SOCKET, SO_SNDTIMEO, &rt, sizeof(rt));
+		if (recv(c, req, sizeof(req), 0) > 0)
+		{
+			string body = Text();
+			ostringstream h;
+			h << "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+			  << "Content-Length: " << body.size() << "\r\nConnection: close\r\n\r\n";
+			string rpl = h.str() + body;
+			const char* p = rpl.data();  size_t left = rpl.size();
+			while (left > 0)
+			{	ssize_t n = send(c, p, left, MSG_NOSIGNAL);
+				if (n <= 0)  break;
+				p += n;  left -= n;
+			}
+		}
+		close(c);
+	}
+}
+#endif
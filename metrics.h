@@ -0,0 +1,87 @@
+#pragma once
+#include "histogram.h"
+#include "atomic_ops.h"
+#include <string>
+#include <cstring>
+#include <ostream>
+#include <vector>
+#include <boost/thread.hpp>
+
+
+///  counter, only goes up, any thread
+struct METRIC_COUNTER
+{
+	volatile unsigned long long v;
+	METRIC_COUNTER() : v(0)  {  }
+	void Add(unsigned long long n = 1)  {  AtomicAdd(v, n);  }
+	unsigned long long Get() const  {  return AtomicLoad(v);  }
+};
+
+///  gauge, last set value, stored as double bits like FF_THREAD force
+struct METRIC_GAUGE
+{
+	volatile long long bits;
+	METRIC_GAUGE() : bits(0)  {  }
+	void Set(double d)
+	{	long long b;  memcpy(&b, &d, sizeof(b));
+		AtomicStore(bits, b);
+	}
+	double Get() const
+	{	long long b = AtomicLoad(bits);
+		double d;  memcpy(&d, &b, sizeof(d));
+		return d;
+	}
+};
+
+///  histogram, the owner's thread publishes a copy of its own one, the scrape reads it
+struct METRIC_HISTOGRAM
+{
+	void Set(const HISTOGRAM_US& h)
+	{	boost::mutex::scoped_lock lock(mutex);
+		last = h;
+	}
+	HISTOGRAM_US Get() const
+	{	boost::mutex::scoped_lock lock(mutex);
+		return last;
+	}
+private:
+	HISTOGRAM_US last;
+	mutable boost::mutex mutex;
+};
+
+
+///  runtime metrics, registered at start, read any time
+//  counters and gauges are updated without locks by the threads that own them,
+//  Text gives them in prometheus text format, Serve answers http on a local port
+class METRICS
+{
+public:
+	METRICS();
+	~METRICS();
+
+	//  names like  sr_ticks_total, returned pointers stay valid
+	METRIC_COUNTER* Counter(const std::string& name, const std::string& help);
+	METRIC_GAUGE* Gauge(const std::string& name, const std::string& help);
+	METRIC_HISTOGRAM* Histogram(const std::string& name, const std::string& help);
+
+	std::string Text() const;
+
+	bool Serve(int port, std::ostream& error_output);  // 127.0.0.1, own thread
+	void Stop();
+
+private:
+	enum TYPE {  COUNTER, GAUGE, HISTOGRAM  };
+	struct ENTRY
+	{	std::string name, help;
+		TYPE type;
+		METRIC_COUNTER* c;  METRIC_GAUGE* g;  METRIC_HISTOGRAM* h;
+	};
+	std::vector<ENTRY> entries;
+	mutable boost::mutex mutex;  // entries, not values
+
+	void Run();
+	boost::thread thread;
+	int sock;
+	volatile bool quit;
+	std::ostream* error_output;
+};
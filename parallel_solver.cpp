@@ -0,0 +1,107 @@
+#include "pch.h"
+#include "parallel_solver.h"
+
+
+PARALLEL_SOLVER::PARALLEL_SOLVER(WORKER_POOL& p)
+	: islandsLast(0), dispatcher(NULL), pool(p)
+{	}
+
+PARALLEL_SOLVER::~PARALLEL_SOLVER()
+{
+	for (size_t i = 0; i < solvers.size(); ++i)
+		delete solvers[i];
+}
+
+void PARALLEL_SOLVER::prepareSolve(int numBodies, int numManifolds)
+{
+	islands.clear();
+	bodies.clear();  manifolds.clear();  constraints.clear();
+	if ((int)bodies.capacity() < numBodies)  bodies.reserve(numBodies);
+	if ((int)manifolds.capacity() < numManifolds)  manifolds.reserve(numManifolds);
+
+	while ((int)solvers.size() < pool.Workers())
+		solvers.push_back(new btSequentialImpulseConstraintSolver());
+}
+
+//  bullet's arrays are reused for the next island, copy the pointers
+btScalar PARALLEL_SOLVER::solveGroup(btCollisionObject** b, int numBodies,
+	btPersistentManifold** m, int numManifolds,
+	btTypedConstraint** c, int numConstraints,
+	const btContactSolverInfo& info, btIDebugDraw* debugDrawer
+	PS_STACK_ALLOC, btDispatcher* disp)
+{
+	ISLAND is;
+	is.body = (int)bodies.size();  is.numBodies = numBodies;
+	is.manifold = (int)manifolds.size();  is.numManifolds = numManifolds;
+	is.constraint = (int)constraints.size();  is.numConstraints = numConstraints;
+	bodies.insert(bodies.end(), b, b + numBodies);
+	manifolds.insert(manifolds.end(), m, m + numManifolds);
+	constraints.insert(constraints.end(), c, c + numConstraints);
+	islands.push_back(is);
+	dispatcher = disp;
+	return 0.f;
+}
+
+//  shares something the solver writes without a lock
+bool PARALLEL_SOLVER::Serial(const ISLAND& is) const
+{
+	if (is.numConstraints > 0)
+		return true;
+	for (int m = is.manifold; m < is.manifold + is.numManifolds; ++m)
+	{
+		//  getBody0 is void* before bullet 2.81
+		const btRigidBody* b0 = btRigidBody::upcast(static_cast<const btCollisionObject*>(manifolds[m]->getBody0()));
+		const btRigidBody* b1 = btRigidBody::upcast(static_cast<const btCollisionObject*>(manifolds[m]->getBody1()));
+		if ((b0 && b0->isKinematicObject()) || (b1 && b1->isKinematicObject()))
+			return true;
+	}
+	return false;
+}
+
+void PARALLEL_SOLVER::SOLVE::Run(int i, int worker)
+{
+	Solve(ps->parallel[i], worker);
+}
+
+void PARALLEL_SOLVER::SOLVE::Solve(int island, int worker)
+{
+	const ISLAND& is = ps->islands[island];
+	btSequentialImpulseConstraintSolver* s = ps->solvers[worker];
+	s->setRandSeed(0);  // same for every island, whoever solves it
+	s->solveGroup(
+		is.numBodies ? &ps->bodies[is.body] : NULL, is.numBodies,
+		is.numManifolds ? &ps->manifolds[is.manifold] : NULL, is.numManifolds,
+		is.numConstraints ? &ps->constraints[is.constraint] : NULL, is.numConstraints,
+		*info, debugDrawer
+	#if BT_BULLET_VERSION < 282
+		, stackAlloc
+	#endif
+		, ps->dispatcher);
+}
+
+void PARALLEL_SOLVER::allSolved(const btContactSolverInfo& info, btIDebugDraw* debugDrawer
+	PS_STACK_ALLOC)
+{
+	btAssert(info.m_minimumSolverBatchSize <= 1 && !(info.m_solverMode & SOLVER_RANDMIZE_ORDER));
+	SOLVE job;
+	job.ps = this;  job.info = &info;
+	job.debugDrawer = pool.Workers() > 1 ? NULL : debugDrawer;  // not thread safe
+#if BT_BULLET_VERSION < 282
+	job.stackAlloc = stackAlloc;
+#endif
+	islandsLast = (int)islands.size();
+	parallel.clear();  serial.clear();
+	for (int i = 0; i < islandsLast; ++i)
+		(Serial(islands[i]) ? serial : parallel).push_back(i);
+
+	pool.For((int)parallel.size(), job);
+	for (size_t i = 0; i < serial.size(); ++i)  // workers are idle now
+		job.Solve(serial[i], 0);
+	islands.clear();
+}
+
+void PARALLEL_SOLVER::reset()
+{
+	for (size_t i = 0; i < solvers.size(); ++i)
+		solvers[i]->reset();
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include "btBulletDynamicsCommon.h"
+#include "worker_pool.h"
+#include <vector>
+
+#if BT_BULLET_VERSION < 282
+	#define PS_STACK_ALLOC  , btStackAlloc* stackAlloc
+#else
+	#define PS_STACK_ALLOC
+#endif
+
+
+///  constraint solver that solves simulation islands in parallel
+//  solveGroup only records each island (bullet calls it per island, in island
+//  order), allSolved then solves them on the worker pool, one sequential
+//  impulse solver per worker; islands share no dynamic bodies
+//  each island is solved with the same seed and on its own, so results don't
+//  depend on thread count or which worker took it
+//  needs m_minimumSolverBatchSize 1 (one call per island) and SOLVER_RANDMIZE_ORDER off;
+//  kinematic bodies get their companion id written by the solver, and constraints use
+//  the one static getFixedBody, so islands with either are solved after, on this thread
+class PARALLEL_SOLVER : public btConstraintSolver
+{
+public:
+	PARALLEL_SOLVER(WORKER_POOL& pool);
+	virtual ~PARALLEL_SOLVER();
+
+	virtual void prepareSolve(int numBodies, int numManifolds);
+	virtual btScalar solveGroup(btCollisionObject** bodies, int numBodies,
+		btPersistentManifold** manifolds, int numManifolds,
+		btTypedConstraint** constraints, int numConstraints,
+		const btContactSolverInfo& info, btIDebugDraw* debugDrawer
+		PS_STACK_ALLOC, btDispatcher* dispatcher);
+	virtual void allSolved(const btContactSolverInfo& info, btIDebugDraw* debugDrawer
+		PS_STACK_ALLOC);
+	virtual void reset();
+#if BT_BULLET_VERSION >= 281
+	virtual btConstraintSolverType getSolverType() const  {  return BT_SEQUENTIAL_IMPULSE_SOLVER;  }
+#endif
+
+	int islandsLast;  // solved in last step
+
+private:
+	struct ISLAND
+	{	int body, numBodies, manifold, numManifolds, constraint, numConstraints;  };
+	std::vector<ISLAND> islands;
+	std::vector<int> parallel, serial;  // island indices
+	bool Serial(const ISLAND& is) const;
+	std::vector<btCollisionObject*> bodies;
+	std::vector<btPersistentManifold*> manifolds;
+	std::vector<btTypedConstraint*> constraints;
+	btDispatcher* dispatcher;
+
+	struct SOLVE : public WORKER_POOL::JOB
+	{
+		PARALLEL_SOLVER* ps;
+		const btContactSolverInfo* info;
+		btIDebugDraw* debugDrawer;
+	#if BT_BULLET_VERSION < 282
+		btStackAlloc* stackAlloc;
+	#endif
+		virtual void Run(int i, int worker);  // i in parallel
+		void Solve(int island, int worker);
+	};
+	WORKER_POOL& pool;
+	std::vector<btSequentialImpulseConstraintSolver*> solvers;  // per worker
+};
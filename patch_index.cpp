@@ -0,0 +1,207 @@
+#include "pch.h"
+#include "patch_index.h"
+#include "roadstrip.h"
+#include "timeus.h"
+#include <algorithm>
+#include <cmath>
+using namespace std;
+
+static const int MAX_CELLS = 1 << 20;
+
+
+PATCH_INDEX::PATCH_INDEX()
+	: cell(20.f), x0(0.f), y0(0.f), nx(0), ny(0)
+{	}
+
+void PATCH_INDEX::Clear()
+{
+	patches.clear();  start.clear();  items.clear();
+	nx = ny = 0;
+}
+
+void PATCH_INDEX::Build(const list<ROADSTRIP>& roads, float cellSize)
+{
+	Clear();
+	float maxX = -1e30f, maxY = -1e30f;
+	x0 = 1e30f;  y0 = 1e30f;
+	for (list<ROADSTRIP>::const_iterator r = roads.begin(); r != roads.end(); ++r)
+	{
+		const list<ROADPATCH>& pl = r->GetPatchList();
+		int first = (int)patches.size();
+		for (list<ROADPATCH>::const_iterator p = pl.begin(); p != pl.end(); ++p)
+		{
+			AABB<float> bb = p->GetPatch().GetAABB();
+			PATCH pt;  pt.p = &*p;
+			pt.minX = bb.GetPos()[0];  pt.maxX = pt.minX + bb.GetSize()[0];
+			pt.minY = bb.GetPos()[1];  pt.maxY = pt.minY + bb.GetSize()[1];
+			pt.maxZ = bb.GetPos()[2] + bb.GetSize()[2];
+			int i = (int)patches.size();
+			pt.prev = i > first ? i-1 : -1;  pt.next = -1;
+			if (pt.prev >= 0)  patches[pt.prev].next = i;
+			patches.push_back(pt);
+
+			x0 = min(x0, pt.minX);  maxX = max(maxX, pt.maxX);
+			y0 = min(y0, pt.minY);  maxY = max(maxY, pt.maxY);
+		}
+	}
+	if (patches.empty())  return;
+
+	//  cell size, bigger if too many cells
+	cell = cellSize;
+	while ((long long)((maxX - x0) / cell + 1) * (long long)((maxY - y0) / cell + 1) > MAX_CELLS)
+		cell *= 2.f;
+	nx = (int)((maxX - x0) / cell) + 1;
+	ny = (int)((maxY - y0) / cell) + 1;
+
+	//  count, offsets, fill
+	start.assign(nx * ny + 1, 0);
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		vector<int> fill;
+		if (pass == 1)
+		{	for (int c = 0; c < nx * ny; ++c)
+				start[c+1] += start[c];
+			items.resize(start[nx * ny]);
+			fill.assign(start.begin(), start.end() - 1);
+		}
+		for (int i = 0; i < (int)patches.size(); ++i)
+		{
+			const PATCH& pt = patches[i];
+			int cx0 = (int)((pt.minX - x0) / cell), cx1 = (int)((pt.maxX - x0) / cell);
+			int cy0 = (int)((pt.minY - y0) / cell), cy1 = (int)((pt.maxY - y0) / cell);
+			for (int y = cy0; y <= cy1; ++y)
+			for (int x = cx0; x <= cx1; ++x)
+				if (pass == 0)  ++start[y * nx + x + 1];
+				else  items[fill[y * nx + x]++] = i;
+		}
+	}
+}
+
+int PATCH_INDEX::Cell(float x, float y) const
+{
+	if (nx == 0 || x < x0 || y < y0)  return -1;
+	int cx = (int)((x - x0) / cell), cy = (int)((y - y0) / cell);
+	if (cx >= nx || cy >= ny)  return -1;
+	return cy * nx + cx;
+}
+
+bool PATCH_INDEX::Hit(int i, const MATHVECTOR<float,3>& origin, float len, MATHVECTOR<float,3>& hit) const
+{
+	const PATCH& pt = patches[i];
+	if (origin[0] < pt.minX || origin[0] > pt.maxX || origin[1] < pt.minY || origin[1] > pt.maxY)
+		return false;
+	MATHVECTOR<float,3> down(0,0,-1), normal;
+	const BEZIER* colpatch = NULL;
+	return pt.p->Collide(origin, down, len, hit, colpatch, normal);
+}
+
+
+///  lookup
+//-----------------------------------------------------------
+const ROADPATCH* PATCH_INDEX::Find(const MATHVECTOR<float,3>& origin, float len,
+	PATCH_CACHE* cache, MATHVECTOR<float,3>& hit) const
+{
+	//  same patch or the next/previous one on that road
+	int best = -1;  float bestZ = -1e30f;
+	if (cache && cache->last >= 0 && cache->last < (int)patches.size())
+	{
+		const PATCH& pt = patches[cache->last];
+		int nb[3] = {  cache->last, pt.next, pt.prev  };
+		for (int k = 0; k < 3 && best < 0; ++k)
+			if (nb[k] >= 0 && Hit(nb[k], origin, len, hit))
+			{	best = nb[k];  bestZ = hit[2];  }
+	}
+	int cached = best;
+
+	//  grid cell, nearest hit (bridges), with a cached hit only patches reaching above it
+	int c = Cell(origin[0], origin[1]);
+	if (c >= 0)
+	{	MATHVECTOR<float,3> h;
+		for (int k = start[c]; k < start[c+1]; ++k)
+		{	int i = items[k];
+			if (i != cached && patches[i].maxZ > bestZ && Hit(i, origin, len, h) && h[2] > bestZ)
+			{	bestZ = h[2];  best = i;  hit = h;  }
+		}
+	}
+	if (cache)
+	{	if (cached >= 0 && best == cached)  ++cache->hits;
+		else  ++cache->misses;
+		cache->last = best;
+	}
+	return best >= 0 ? patches[best].p : NULL;
+}
+
+const ROADPATCH* PATCH_INDEX::FindLinear(const MATHVECTOR<float,3>& origin, float len,
+	MATHVECTOR<float,3>& hit) const
+{
+	int best = -1;  float bestZ = -1e30f;
+	MATHVECTOR<float,3> h;
+	for (int i = 0; i < (int)patches.size(); ++i)
+		if (Hit(i, origin, len, h) && h[2] > bestZ)
+		{	bestZ = h[2];  best = i;  hit = h;  }
+	return best >= 0 ? patches[best].p : NULL;
+}
+
+
+///  benchmark
+//-----------------------------------------------------------
+void PATCH_INDEX::Bench(int lookups, ostream& info_output) const
+{
+	if (patches.empty())
+	{	info_output << "Patch bench: track has no road patches" << endl;
+		return;
+	}
+	//  4 wheels crossing each patch in road order, a few steps per patch
+	const int steps = 8;
+	vector<MATHVECTOR<float,3> > pos;
+	pos.reserve(lookups);
+	for (int i = 0; (int)pos.size() < lookups; i = (i + 1) % (int)patches.size())
+	{
+		AABB<float> bb = patches[i].p->GetPatch().GetAABB();
+		const MATHVECTOR<float,3>& a = bb.GetPos(), & s = bb.GetSize();
+		for (int t = 0; t < steps && (int)pos.size() < lookups; ++t)
+		for (int w = 0; w < 4 && (int)pos.size() < lookups; ++w)
+		{	float fx = (t + 0.5f) / steps, fy = 0.3f + 0.4f * (w & 1);
+			pos.push_back(MATHVECTOR<float,3>(a[0] + s[0] * fx, a[1] + s[1] * fy, a[2] + s[2] + 1.f));
+		}
+	}
+	float len = 1e4f;
+	MATHVECTOR<float,3> h;
+	unsigned int found[3] = {0,0,0}, diff = 0;
+	double rate[3];
+
+	//  linear is slow, fewer of them
+	int nLin = min(lookups, max(1000, lookups / 50));
+	unsigned long long t = GetTimeUs();
+	for (int i = 0; i < nLin; ++i)
+		if (FindLinear(pos[i], len, h))  ++found[0];
+	rate[0] = nLin / max(1e-6, (GetTimeUs() - t) * 1e-6);
+
+	t = GetTimeUs();
+	for (int i = 0; i < lookups; ++i)
+		if (Find(pos[i], len, NULL, h))  ++found[1];
+	rate[1] = lookups / max(1e-6, (GetTimeUs() - t) * 1e-6);
+
+	PATCH_CACHE wheel[4];
+	t = GetTimeUs();
+	for (int i = 0; i < lookups; ++i)
+		if (Find(pos[i], len, &wheel[i & 3], h))  ++found[2];
+	rate[2] = lookups / max(1e-6, (GetTimeUs() - t) * 1e-6);
+
+	//  same patch as linear, grid and cached (own caches, same wheel order)
+	PATCH_CACHE check[4];
+	for (int i = 0; i < nLin; ++i)
+	{	const ROADPATCH* p = FindLinear(pos[i], len, h);
+		if (p != Find(pos[i], len, NULL, h))  ++diff;
+		if (p != Find(pos[i], len, &check[i & 3], h))  ++diff;
+	}
+
+	unsigned int hits = 0, misses = 0;
+	for (int w = 0; w < 4; ++w)
+	{	hits += wheel[w].hits;  misses += wheel[w].misses;  }
+	info_output << "Patch bench: " << patches.size() << " patches, grid " << nx << "x" << ny << " of " << cell << " m, "
+		<< lookups << " lookups, per s: linear " << (unsigned long long)rate[0]
+		<< ", grid " << (unsigned long long)rate[1] << ", cached " << (unsigned long long)rate[2]
+		<< " (" << (hits + misses ? 100 * hits / (hits + misses) : 0) << "% hits), found "
+		<< found[1] << ", differ from linear " << diff << " (grid and cached)" << endl;
+}
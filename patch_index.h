@@ -0,0 +1,65 @@
+#pragma once
+#include "mathvector.h"
+#include <list>
+#include <vector>
+#include <ostream>
+
+class ROADSTRIP;
+class ROADPATCH;
+
+
+///  last patch a wheel was on, checked first with its road neighbours
+struct PATCH_CACHE
+{
+	int last;  // patch index, -1 none
+	unsigned int hits, misses;
+	PATCH_CACHE() : last(-1), hits(0), misses(0)  {  }
+};
+
+
+///  uniform 2d grid over all road patches of a track (x,y, z is up)
+//  each cell lists the patches whose bounding box overlaps it, so a ray down
+//  from a wheel tests only a few patches instead of every road's list
+//  cells are in one array (start offsets + items), built once per track load
+//  benchmark only (-patchbench): the wheel rays in COLLISION_WORLD don't use it,
+//  they still test each road's patches; Find with a PATCH_CACHE per wheel is
+//  meant to replace that loop there
+class PATCH_INDEX
+{
+public:
+	PATCH_INDEX();
+
+	void Build(const std::list<ROADSTRIP>& roads, float cellSize = 20.f);
+	void Clear();
+	int Patches() const  {  return (int)patches.size();  }
+
+	//  ray down from origin, len long, nearest hit patch or NULL
+	//  with cache: its last patch and road neighbours first, a hit there is
+	//  only kept if no other patch in the grid cell can be hit higher (bridges)
+	const ROADPATCH* Find(const MATHVECTOR<float,3>& origin, float len,
+		PATCH_CACHE* cache, MATHVECTOR<float,3>& hit) const;
+
+	//  all patches, for comparison
+	const ROADPATCH* FindLinear(const MATHVECTOR<float,3>& origin, float len,
+		MATHVECTOR<float,3>& hit) const;
+
+	//  lookups per second: linear, grid, grid with per wheel caches
+	//  wheels driving along the roads, 4 at a time like a car
+	void Bench(int lookups, std::ostream& info_output) const;
+
+private:
+	struct PATCH
+	{	const ROADPATCH* p;
+		int prev, next;  // in same road, -1
+		float minX, minY, maxX, maxY, maxZ;
+	};
+	std::vector<PATCH> patches;
+
+	float cell, x0, y0;
+	int nx, ny;
+	std::vector<int> start;  // nx*ny+1, into items
+	std::vector<int> items;
+
+	int Cell(float x, float y) const;  // -1 outside
+	bool Hit(int i, const MATHVECTOR<float,3>& origin, float len, MATHVECTOR<float,3>& hit) const;
+};
@@ -1,14 +1,20 @@
+import sys
 import zmq
 
+# usage: pyclient.py [oneway]
+#   oneway - send commands without waiting for a reply (game run with -remote-oneway)
+#   several commands can go in one line, separated by ;  e.g.  throttle 100;steer -20
+oneway = len(sys.argv) > 1 and sys.argv[1] == "oneway"
+
 context = zmq.Context()
 
 # Socket to talk to server
 print("Connecting to hello world server...")
-socket = context.socket(zmq.REQ)
+socket = context.socket(zmq.DEALER if oneway else zmq.REQ)
 socket.connect("tcp://localhost:5555")
 while True:
     socket.send(raw_input("command:"))
-    # Get the reply.
-    message = socket.recv()
-    print "Received reply [ %s ]" % (message)
-
+    if not oneway:
+        # Get the reply.
+        message = socket.recv()
+        print "Received reply [ %s ]" % (message)
@@ -0,0 +1,34 @@
+import mmap, os, struct, sys, time
+
+# local agent over shared memory, game run with  -shm stuntrally
+# layout in shm_transport.h
+HDR, RING, CARS = 192, 1024, 16
+CMD_SIZE, CAR_SIZE = 16, 60
+HEAD, TAIL = 64, 128
+CAR_OFS = HDR + RING * CMD_SIZE
+TYPES = {"throttle": 1, "brake": 2, "steer": 3, "release": 4, "boostmax": 5, "boost": 6}
+
+fd = os.open("/dev/shm/" + (sys.argv[1] if len(sys.argv) > 1 else "stuntrally"), os.O_RDWR)
+m = mmap.mmap(fd, CAR_OFS + CARS * CAR_SIZE)
+
+def send(name, value=0.0, car=-1):
+    head, tail = struct.unpack_from("I", m, HEAD)[0], struct.unpack_from("I", m, TAIL)[0]
+    if head - tail >= RING:
+        return False  # full
+    struct.pack_into("iifI", m, HDR + (head % RING) * CMD_SIZE, TYPES[name], car, value, 0)
+    struct.pack_into("I", m, HEAD, (head + 1) & 0xffffffff)
+    return True
+
+def car(slot):
+    ofs = CAR_OFS + slot * CAR_SIZE
+    while True:  # seqlock read
+        s1 = struct.unpack_from("I", m, ofs)[0]
+        data = struct.unpack_from("I3f4f3fffi", m, ofs + 4)
+        if s1 % 2 == 0 and s1 == struct.unpack_from("I", m, ofs)[0]:
+            return data
+
+send("throttle", 100)
+while True:
+    frame, x, y, z = car(0)[:4]
+    print("frame %d  pos %.1f %.1f %.1f" % (frame, x, y, z))
+    time.sleep(0.5)
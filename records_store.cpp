@@ -0,0 +1,172 @@
+#include "pch.h"
+#include "records_store.h"
+#include <cstring>
+#include <ctime>
+#ifndef _WIN32
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+using namespace std;
+
+static const char sMagic[16] = "SRRECORDS1";
+
+
+RECORDS_STORE::RECORDS_STORE()
+	: fd(-1), scanned(0)
+{	}
+
+RECORDS_STORE::~RECORDS_STORE()
+{
+	Close();
+}
+
+bool RECORDS_STORE::Open(const string& file, ostream& error_output)
+{
+	Close();
+#ifdef _WIN32
+	return false;
+#else
+	path = file;
+	//  first to create it writes the header
+	int f = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+	if (f >= 0)
+	{
+		if (write(f, sMagic, sizeof(sMagic)) != (ssize_t)sizeof(sMagic))
+		{	close(f);
+			error_output << "Records: can't write " << path << endl;
+			return false;
+		}
+		close(f);
+	}
+	fd = open(path.c_str(), O_RDWR | O_APPEND);
+	if (fd < 0)
+	{	error_output << "Records: can't open " << path << endl;
+		return false;
+	}
+
+	char magic[sizeof(sMagic)];
+	if (read(fd, magic, sizeof(magic)) != (ssize_t)sizeof(magic) || memcmp(magic, sMagic, sizeof(magic)) != 0)
+	{	error_output << "Records: not a records file: " << path << endl;
+		Close();
+		return false;
+	}
+	scanned = sizeof(sMagic);
+	Scan();
+	return true;
+#endif
+}
+
+void RECORDS_STORE::Close()
+{
+#ifndef _WIN32
+	if (fd >= 0)
+		close(fd);
+#endif
+	fd = -1;  scanned = 0;
+	index.clear();
+}
+
+void RECORDS_STORE::Refresh()
+{
+	if (fd >= 0)
+		Scan();
+}
+
+
+///  index
+//-----------------------------------------------------------
+//  names cut to the file's field sizes
+string RECORDS_STORE::Key(const string& track, bool reverse, const string& car, const string& sim_mode)
+{
+	ENTRY e;
+	string k = track.substr(0, sizeof(e.track));
+	k += reverse ? "|r|" : "||";
+	k += car.substr(0, sizeof(e.car));  k += "|";
+	k += sim_mode.substr(0, sizeof(e.sim_mode));
+	return k;
+}
+
+void RECORDS_STORE::Index(const ENTRY& e)
+{
+	//  names may fill the whole field, no 0 at end
+	string key = Key(string(e.track, strnlen(e.track, sizeof(e.track))), e.reverse != 0,
+		string(e.car, strnlen(e.car, sizeof(e.car))),
+		string(e.sim_mode, strnlen(e.sim_mode, sizeof(e.sim_mode))));
+	map<string, BEST>::iterator it = index.find(key);
+	if (it == index.end())
+	{	BEST b;  b.lap = e.lap;  b.laps = 1;
+		index[key] = b;
+	}else
+	{	++it->second.laps;
+		if (e.lap < it->second.lap)
+			it->second.lap = e.lap;
+	}
+}
+
+//  index entries added since last scan, mapped not read
+void RECORDS_STORE::Scan()
+{
+#ifndef _WIN32
+	struct stat st;
+	if (fstat(fd, &st) != 0)  return;
+	unsigned long long size = scanned + (st.st_size - scanned) / sizeof(ENTRY) * sizeof(ENTRY);
+	if (size <= scanned)  return;
+
+	long page = sysconf(_SC_PAGESIZE);
+	unsigned long long start = scanned / page * page;
+	size_t len = size - start;
+	void* p = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, start);
+	if (p == MAP_FAILED)  return;
+
+	const char* d = (const char*)p + (scanned - start);
+	size_t n = (size - scanned) / sizeof(ENTRY);
+	for (size_t i = 0; i < n; ++i)
+	{
+		ENTRY e;
+		memcpy(&e, d + i * sizeof(ENTRY), sizeof(ENTRY));
+		Index(e);
+	}
+	munmap(p, len);
+	scanned = size;
+#endif
+}
+
+
+///  append
+//-----------------------------------------------------------
+bool RECORDS_STORE::Append(const string& track, bool reverse, const string& car,
+	const string& sim_mode, float lapTime)
+{
+#ifdef _WIN32
+	return false;
+#else
+	if (fd < 0)  return false;
+	ENTRY e;
+	memset(&e, 0, sizeof(e));
+	strncpy(e.track, track.c_str(), sizeof(e.track));
+	strncpy(e.car, car.c_str(), sizeof(e.car));
+	strncpy(e.sim_mode, sim_mode.c_str(), sizeof(e.sim_mode));
+	e.reverse = reverse ? 1 : 0;
+	e.lap = lapTime;
+	e.time = (unsigned long long)time(NULL);
+
+	//  one write, whole entry at end of file
+	if (write(fd, &e, sizeof(e)) != (ssize_t)sizeof(e))
+		return false;
+	Scan();  // own entry and any others before it
+	return true;
+#endif
+}
+
+bool RECORDS_STORE::Best(const string& track, bool reverse, const string& car,
+	const string& sim_mode, float& lapTime, unsigned int* laps) const
+{
+	map<string, BEST>::const_iterator it = index.find(Key(track, reverse, car, sim_mode));
+	if (it == index.end())
+		return false;
+	lapTime = it->second.lap;
+	if (laps)  *laps = it->second.laps;
+	return true;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <string>
+#include <map>
+#include <ostream>
+
+
+///  lap records, binary file of fixed size entries, only appended to
+//  opened once per process: the file is memory mapped and scanned into an
+//  index of best lap per track/car/sim_mode, new laps are appended with one
+//  write (O_APPEND, so farm workers can share the file); Refresh picks up
+//  entries others appended since
+class RECORDS_STORE
+{
+public:
+	RECORDS_STORE();
+	~RECORDS_STORE();
+
+	bool Open(const std::string& path, std::ostream& error_output);
+	void Close();
+	bool IsOpen() const  {  return fd >= 0;  }
+	void Refresh();
+
+	bool Append(const std::string& track, bool reverse, const std::string& car,
+		const std::string& sim_mode, float lapTime);
+
+	//  false if no lap yet
+	bool Best(const std::string& track, bool reverse, const std::string& car,
+		const std::string& sim_mode, float& lapTime, unsigned int* laps = NULL) const;
+
+	struct ENTRY  // in file, 128 bytes
+	{
+		char track[64], car[16], sim_mode[16];
+		unsigned char reverse, pad[3];
+		float lap;
+		unsigned long long time;  // unix seconds
+		char reserved[16];
+	};
+
+private:
+	static std::string Key(const std::string& track, bool reverse, const std::string& car, const std::string& sim_mode);
+	void Index(const ENTRY& e);
+	void Scan();
+
+	struct BEST
+	{	float lap;  unsigned int laps;  };
+	std::map<std::string, BEST> index;
+	int fd;
+	unsigned long long scanned;  // file bytes in index
+	std::string path;
+};
@@ -0,0 +1,164 @@
+#include "pch.h"
+#include "remote_cmd.h"
+#include "cardefs.h"
+#include "carcontrolmap_local.h"
+#include <cstring>
+#include <cmath>
+using namespace std;
+
+
+static const char* sCmdNames[REMOTE_CMD::ALL] =
+{	"", "throttle", "brake", "steer", "release", "boostmax", "boost",
+	"claim", "unclaim", "bye",
+	"snap", "restore", "latency",
+	"tire", "surf"  };
+
+static const char* sSurfParams[SP_ALL] =
+{	"friction", "frictionX", "frictionY", "rollResist", "rollDrag",
+	"bumpWave", "bumpAmp", "bumpWave2", "bumpAmp2"  };
+
+const char* RemoteCmdName(REMOTE_CMD::TYPE type)
+{
+	return type > REMOTE_CMD::NONE && type < REMOTE_CMD::ALL ? sCmdNames[type] : "";
+}
+
+//  number from a buffer that is not 0 terminated
+static bool ParseNum(const char*& p, const char* end, float& f)
+{
+	bool neg = false;
+	if (p < end && (*p == '-' || *p == '+'))
+	{	neg = *p == '-';  ++p;  }
+	const char* b = p;
+	double v = 0.0, frac = 0.1;
+	while (p < end && *p >= '0' && *p <= '9')
+		v = v * 10.0 + (*p++ - '0');
+	if (p < end && *p == '.')
+		for (++p; p < end && *p >= '0' && *p <= '9'; ++p, frac *= 0.1)
+			v += (*p - '0') * frac;
+	f = (float)(neg ? -v : v);
+	return p > b;
+}
+
+//  tire a0..a14 b0..b10 c0..c17, or surface param name
+static bool ParseParam(REMOTE_CMD::TYPE type, const char* p, const char* end, short& param)
+{
+	size_t len = end - p;
+	if (type == REMOTE_CMD::SURFACE)
+	{
+		for (int i = 0; i < SP_ALL; ++i)
+			if (strlen(sSurfParams[i]) == len && memcmp(p, sSurfParams[i], len) == 0)
+			{	param = i;  return true;  }
+		return false;
+	}
+	if (len < 2 || len > 3)  return false;
+	const int base = *p == 'a' ? 0 : *p == 'b' ? 100 : *p == 'c' ? 200 : -1,
+		count = *p == 'a' ? 15 : *p == 'b' ? 11 : 18;
+	float n;  ++p;
+	if (base < 0 || !ParseNum(p, end, n) || p != end || n < 0.f || (int)n >= count)
+		return false;
+	param = base + (int)n;
+	return true;
+}
+
+//  parse  [car:]name [value]  straight from the message buffer, no copies
+bool ParseRemoteCmd(const char* data, size_t len, REMOTE_CMD& cmd)
+{
+	cmd = REMOTE_CMD();
+	const char* p = data, *end = data + len;
+	while (p < end && (*p == ' ' || *p == '\t'))  ++p;
+	while (end > p && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r'))  --end;
+
+	//  car id prefix
+	const char* c = (const char*)memchr(p, ':', end - p);
+	if (c)
+	{	float id;
+		if (!ParseNum(p, c, id) || p != c)
+			return false;
+		cmd.car = (int)id;  p = c + 1;
+	}
+
+	//  name
+	const char* n = p;
+	while (p < end && *p != ' ' && *p != '\t' && !(*p >= '0' && *p <= '9' && p > n))  ++p;
+	size_t nlen = p - n;
+	for (int i = REMOTE_CMD::NONE+1; i < REMOTE_CMD::ALL; ++i)
+		if (strlen(sCmdNames[i]) == nlen && memcmp(n, sCmdNames[i], nlen) == 0)
+			cmd.type = (REMOTE_CMD::TYPE)i;
+	if (cmd.type == REMOTE_CMD::NONE)
+		return false;
+
+	//  param name
+	if (cmd.type == REMOTE_CMD::TIRE || cmd.type == REMOTE_CMD::SURFACE)
+	{
+		while (p < end && *p == ' ')  ++p;
+		const char* t = p;
+		while (p < end && *p != ' ' && *p != '\t')  ++p;
+		if (cmd.car < 0 || !ParseParam(cmd.type, t, p, cmd.param))
+			return false;
+	}
+
+	//  value, old names have it glued: brake100, brake0, boost2
+	while (p < end && *p == ' ')  ++p;
+	if (p < end && !ParseNum(p, end, cmd.value))
+		return false;
+	return p == end;
+}
+
+//  commands separated by new line or ;
+bool ParseRemoteCmds(const char* data, size_t len, vector<REMOTE_CMD>& out)
+{
+	bool ok = true;
+	const char* p = data, *end = data + len;
+	while (p < end)
+	{
+		const char* e = p;
+		while (e < end && *e != '\n' && *e != ';')  ++e;
+		if (e > p)
+		{	REMOTE_CMD cmd;
+			if (ParseRemoteCmd(p, e - p, cmd))
+				out.push_back(cmd);
+			else
+				ok = false;
+		}
+		p = e + 1;
+	}
+	return ok;
+}
+
+
+///  remote input overrides
+//-----------------------------------------------------------
+REMOTE_INPUT::REMOTE_INPUT()
+	: throttle(0.f), brake(0.f), steer(0.f)
+	, hasThrottle(false), hasBrake(false), hasSteer(false)
+{	}
+
+static float Clamp01(float f)
+{
+	return f < 0.f ? 0.f : (f > 1.f ? 1.f : f);
+}
+
+bool REMOTE_INPUT::Set(const REMOTE_CMD& cmd)
+{
+	switch (cmd.type)
+	{
+	case REMOTE_CMD::THROTTLE:  throttle = Clamp01(cmd.value * 0.01f);  hasThrottle = true;  return true;
+	case REMOTE_CMD::BRAKE:     brake = Clamp01(cmd.value * 0.01f);  hasBrake = true;  return true;
+	case REMOTE_CMD::STEER:
+		steer = Clamp01(fabs(cmd.value) * 0.01f);
+		if (cmd.value < 0.f)  steer = -steer;
+		hasSteer = true;  return true;
+	case REMOTE_CMD::RELEASE:   *this = REMOTE_INPUT();  return true;
+	default:  return false;
+	}
+}
+
+void REMOTE_INPUT::Apply(vector<float>& carinputs) const
+{
+	if (hasThrottle)  carinputs[CARINPUT::THROTTLE] = throttle;
+	if (hasBrake)     carinputs[CARINPUT::BRAKE] = brake;
+	if (hasSteer)
+	{	carinputs[CARINPUT::STEER_RIGHT] = steer > 0.f ?  steer : 0.f;
+		carinputs[CARINPUT::STEER_LEFT]  = steer < 0.f ? -steer : 0.f;
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <string>
+#include <vector>
+
+
+///  one command from the remote control channel
+//  text form:  [car:]name [value]   e.g. "brake 100", "1:steer -40", "boostmax"
+//  (value in plain decimal, no exponent)
+//  old names brake100, brake0, boost2 are still accepted
+//  params:  id:tire param value  e.g. "3:tire a5 1.2",  id:surf param value  "0:surf friction 0.9"
+struct REMOTE_CMD
+{
+	enum TYPE
+	{	NONE=0,
+		THROTTLE, BRAKE, STEER,  // input overrides, value in % (steer -100..100)
+		RELEASE,                 // give inputs back to the player
+		BOOST_MAX, BOOST_ADD,    // boost fuel
+		CLAIM, UNCLAIM, BYE,     // session: own a car, give it back, end session
+		SNAPSHOT, RESTORE,       // whole simulation, value is slot
+		LATENCY,                 // reply: receive to apply times
+		TIRE, SURFACE,           // set one param, prefix is tire or surface id
+		ALL
+	};
+	TYPE type;
+	int car;      // car id, -1 = no prefix, car 0 (RemoteCmdCar)
+	float value;
+	unsigned long long recvUs;  // GetTimeUs when received, 0 if not from network
+	short param;  // TIRE: a0..a14 = 0.., b0..b10 = 100.., c0..c17 = 200..,  SURFACE: SURF_PARAM
+
+	REMOTE_CMD() : type(NONE), car(-1), value(0.f), recvUs(0), param(-1)  {  }
+};
+
+bool ParseRemoteCmd(const char* data, size_t len, REMOTE_CMD& cmd);
+inline bool ParseRemoteCmd(const std::string& str, REMOTE_CMD& cmd)
+{	return ParseRemoteCmd(str.data(), str.size(), cmd);  }
+//  several commands in one buffer, separated by new line or ;  false if any was bad
+bool ParseRemoteCmds(const char* data, size_t len, std::vector<REMOTE_CMD>& out);
+const char* RemoteCmdName(REMOTE_CMD::TYPE type);
+//  car a command is for, same for ownership and apply
+inline int RemoteCmdCar(const REMOTE_CMD& cmd)
+{	return cmd.car >= 0 ? cmd.car : 0;  }
+//  not for one car and changes nothing, no ownership check
+inline bool RemoteCmdIsGlobal(REMOTE_CMD::TYPE type)
+{	return type == REMOTE_CMD::SNAPSHOT || type == REMOTE_CMD::LATENCY;  }
+//  changes all cars (tires are shared by type, surfaces by track, restore rewinds all),
+//  only from a session owning every car, or any client with -remote-admin
+inline bool RemoteCmdIsShared(REMOTE_CMD::TYPE type)
+{	return type == REMOTE_CMD::RESTORE || type == REMOTE_CMD::TIRE || type == REMOTE_CMD::SURFACE;  }
+
+//  surface params, names in text form
+enum SURF_PARAM
+{	SP_FRICTION=0, SP_FRICTION_X, SP_FRICTION_Y, SP_ROLL_RESIST, SP_ROLL_DRAG,
+	SP_BUMP_WAVE, SP_BUMP_AMP, SP_BUMP_WAVE2, SP_BUMP_AMP2, SP_ALL  };
+
+
+///  remote overrides of one car's inputs, kept until RELEASE
+struct REMOTE_INPUT
+{
+	float throttle, brake, steer;
+	bool hasThrottle, hasBrake, hasSteer;
+
+	REMOTE_INPUT();
+	bool Set(const REMOTE_CMD& cmd);  // false if not an input cmd
+	void Apply(std::vector<float>& carinputs) const;
+};
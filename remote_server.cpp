@@ -0,0 +1,267 @@
+#include "pch.h"
+#include "remote_server.h"
+#include "timeus.h"
+#include <algorithm>
+#include <cstring>
+#include <zmq.hpp>
+using namespace std;
+
+
+///  session
+//-----------------------------------------------------------
+REMOTE_SESSION::REMOTE_SESSION()
+	: received(0), dropped(0), lastUs(0), head(0), count(0)
+{	}
+
+void REMOTE_SESSION::Push(const REMOTE_CMD& cmd, size_t maxSize)
+{
+	if (ring.size() != maxSize)
+	{	ring.resize(maxSize);  head = 0;  count = 0;  }
+
+	++received;
+	if (count == ring.size())
+	{	head = (head + 1) % ring.size();  // drop oldest
+		--count;  ++dropped;
+	}
+	ring[(head + count) % ring.size()] = cmd;
+	++count;
+}
+
+bool REMOTE_SESSION::Pop(REMOTE_CMD& cmd)
+{
+	if (count == 0)  return false;
+	cmd = ring[head];
+	head = (head + 1) % ring.size();
+	--count;
+	return true;
+}
+
+
+///  server
+//-----------------------------------------------------------
+REMOTE_SERVER::REMOTE_SERVER()
+	: queueMax(1024), idleSec(60), log(NULL), received(NULL), admin(false)
+	, rrStart(0), cars(0), idleCheckUs(0), quit(false)
+{	}
+
+void REMOTE_SERVER::Run(const char* endpoint, bool oneWay)
+{
+	zmq::context_t context(1);
+	zmq::socket_t socket(context, ZMQ_ROUTER);
+	int linger = 0;  // unsent replies don't hold up Stop
+	socket.setsockopt(ZMQ_LINGER, &linger, sizeof(linger));
+	socket.bind(endpoint);
+
+	//  reused for every message, small ones are stored inline by zmq (no heap)
+	zmq::message_t ident, part, reply;
+	vector<REMOTE_CMD> batch;
+	batch.reserve(256);
+	string id;
+
+	zmq_pollitem_t item = {  socket, 0, ZMQ_POLLIN, 0  };
+	while (!quit)
+	{
+		//  wake up to check quit
+		if (zmq::poll(&item, 1, ZMQ_VERSION_MAJOR < 3 ? 200000 : 200) <= 0)  // us before zmq 3
+			continue;
+
+		//  [routing id] [empty, from REQ only] [commands] ...
+		socket.recv(&ident);
+		id.assign(static_cast<const char*>(ident.data()), ident.size());
+
+		batch.clear();
+		bool ok = true, delim = false, first = true;
+		int more = 0;
+		size_t moreSize = sizeof(more);
+		socket.getsockopt(ZMQ_RCVMORE, &more, &moreSize);
+		while (more)
+		{
+			socket.recv(&part);
+			if (first && part.size() == 0)
+				delim = true;
+			else
+				ok &= ParseRemoteCmds(static_cast<const char*>(part.data()), part.size(), batch);
+			first = false;
+			socket.getsockopt(ZMQ_RCVMORE, &more, &moreSize);
+		}
+		unsigned long long now = GetTimeUs();
+		for (size_t i = 0; i < batch.size(); ++i)
+			batch[i].recvUs = now;
+		if (received)
+			received->Add(batch.size());
+
+		const char* rpl = Handle(id, batch, ok);
+
+		if (!oneWay)
+		{	// Send reply back to client
+			ident.rebuild(id.size());
+			memcpy(ident.data(), id.data(), id.size());
+			socket.send(ident, ZMQ_SNDMORE);
+			if (delim)
+			{	part.rebuild(0);
+				socket.send(part, ZMQ_SNDMORE);
+			}
+			reply.rebuild(strlen(rpl));
+			memcpy(reply.data(), rpl, reply.size());
+			socket.send(reply);
+		}
+	}
+}
+
+const char* REMOTE_SERVER::Handle(const string& id, const vector<REMOTE_CMD>& batch, bool parsedOk)
+{
+	boost::lock_guard<boost::mutex> lock(mutex);
+	bool denied = false, latencyReq = false;
+	unsigned long long now = GetTimeUs();
+	CloseIdle(now);
+
+	Sessions::iterator si = sessions.find(id);
+	if (si == sessions.end())
+	{	si = sessions.insert(make_pair(id, REMOTE_SESSION())).first;
+		if (log)
+			*log << "Remote: new session, " << sessions.size() << " open" << endl;
+	}
+	si->second.lastUs = now;
+	if (!parsedOk && log)
+		*log << "Remote: unknown command in message" << endl;
+
+	for (size_t i = 0; i < batch.size(); ++i)
+	{
+		const REMOTE_CMD& cmd = batch[i];
+		REMOTE_SESSION& ses = si->second;
+		//  no prefix means car 0, as in ApplyRemoteCmd
+		int car = cmd.type == REMOTE_CMD::CLAIM || cmd.type == REMOTE_CMD::UNCLAIM ? (cmd.car >= 0 ? cmd.car : (int)cmd.value)
+			: RemoteCmdCar(cmd);
+		map<int, string>::iterator own = owners.find(car);
+
+		switch (cmd.type)
+		{
+		case REMOTE_CMD::CLAIM:
+			if (own == owners.end())
+			{	owners[car] = id;
+				ses.cars.push_back(car);
+			}
+			else if (own->second != id)
+				denied = true;
+			break;
+
+		case REMOTE_CMD::UNCLAIM:
+			if (own != owners.end() && own->second == id)
+			{	owners.erase(own);
+				ses.cars.erase(find(ses.cars.begin(), ses.cars.end(), car));
+			}
+			break;
+
+		case REMOTE_CMD::LATENCY:  // answered here
+			latencyReq = true;
+			break;
+
+		case REMOTE_CMD::BYE:
+			Close(si);
+			return parsedOk && !denied ? "OK" : "ERR";
+
+		default:
+			if (RemoteCmdIsShared(cmd.type) ? !admin && !OwnsAll(id)
+				: own != owners.end() && own->second != id && !RemoteCmdIsGlobal(cmd.type))
+				denied = true;  // someone else drives it
+			else
+				ses.Push(cmd, queueMax);
+		}
+	}
+	if (latencyReq && parsedOk && !denied)
+	{	replyText = latency.Summary();
+		return replyText.c_str();
+	}
+	return !parsedOk ? "ERR" : denied ? "DENIED" : "OK";
+}
+
+void REMOTE_SERVER::PublishLatency(const HISTOGRAM_US& h)
+{
+	boost::lock_guard<boost::mutex> lock(mutex);
+	latency = h;
+}
+
+void REMOTE_SERVER::SetCars(unsigned int count)
+{
+	boost::lock_guard<boost::mutex> lock(mutex);
+	cars = count;
+}
+
+bool REMOTE_SERVER::OwnsAll(const string& id) const
+{
+	if (cars == 0)
+		return false;
+	for (unsigned int c = 0; c < cars; ++c)
+	{
+		map<int, string>::const_iterator own = owners.find(c);
+		if (own == owners.end() || own->second != id)
+			return false;
+	}
+	return true;
+}
+
+size_t REMOTE_SERVER::CheckLocal(vector<REMOTE_CMD>& cmds, size_t from)
+{
+	boost::lock_guard<boost::mutex> lock(mutex);
+	size_t n = from;
+	for (size_t i = from; i < cmds.size(); ++i)
+	{
+		const REMOTE_CMD& cmd = cmds[i];
+		bool ok = RemoteCmdIsShared(cmd.type) ? admin
+			: RemoteCmdIsGlobal(cmd.type) || owners.find(RemoteCmdCar(cmd)) == owners.end();
+		if (ok)
+			cmds[n++] = cmd;
+	}
+	size_t dropped = cmds.size() - n;
+	cmds.resize(n);
+	return dropped;
+}
+
+void REMOTE_SERVER::Close(Sessions::iterator si)
+{
+	for (size_t c = 0; c < si->second.cars.size(); ++c)
+		owners.erase(si->second.cars[c]);
+	sessions.erase(si);
+}
+
+void REMOTE_SERVER::CloseIdle(unsigned long long now)
+{
+	if (idleSec == 0 || now < idleCheckUs + 1000000ull)
+		return;
+	idleCheckUs = now;
+	unsigned long long idleUs = idleSec * 1000000ull;
+	for (Sessions::iterator it = sessions.begin(); it != sessions.end(); )
+	{
+		Sessions::iterator cur = it++;
+		if (now - cur->second.lastUs < idleUs)
+			continue;
+		size_t cars = cur->second.cars.size();
+		Close(cur);
+		if (log)
+			*log << "Remote: session idle " << idleSec << " s closed, " << cars << " cars freed, "
+				<< sessions.size() << " open" << endl;
+	}
+}
+
+void REMOTE_SERVER::Drain(vector<REMOTE_CMD>& out, unsigned int perSession)
+{
+	out.clear();
+	boost::lock_guard<boost::mutex> lock(mutex);
+	CloseIdle(GetTimeUs());
+	size_t n = sessions.size();
+	if (n == 0)  return;
+
+	//  rotate who goes first, so no session always wins on shared cars
+	rrStart = (rrStart + 1) % n;
+	Sessions::iterator it = sessions.begin();
+	advance(it, rrStart);
+
+	for (size_t s = 0; s < n; ++s)
+	{
+		REMOTE_CMD cmd;
+		for (unsigned int c = 0; c < perSession && it->second.Pop(cmd); ++c)
+			out.push_back(cmd);
+		if (++it == sessions.end())
+			it = sessions.begin();
+	}
+}
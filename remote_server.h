@@ -0,0 +1,84 @@
+#pragma once
+#include "remote_cmd.h"
+#include "histogram.h"
+#include "metrics.h"
+#include <map>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+
+
+///  one connected controller, keyed by its zmq routing id
+class REMOTE_SESSION
+{
+public:
+	REMOTE_SESSION();
+
+	//  bounded queue, oldest command dropped when full
+	void Push(const REMOTE_CMD& cmd, size_t maxSize);
+	bool Pop(REMOTE_CMD& cmd);
+
+	std::vector<int> cars;  // claimed car ids
+	unsigned int received, dropped;
+	unsigned long long lastUs;  // last message, for idle timeout
+
+private:
+	std::vector<REMOTE_CMD> ring;
+	size_t head, count;
+};
+
+
+///  remote command server on a ROUTER socket
+//  any number of clients (REQ or DEALER), each gets a session with own queue,
+//  cars claimed by a session only take input commands from it,
+//  unclaimed cars take commands from everyone,
+//  shared commands (RemoteCmdIsShared) need all cars owned or admin
+//  sessions silent for idleSec are closed like on bye (crashed clients)
+class REMOTE_SERVER
+{
+public:
+	REMOTE_SERVER();
+
+	//  server thread body, returns after Stop
+	void Run(const char* endpoint, bool oneWay);
+	//  any thread, Run returns within 200 ms, join the thread after it
+	void Stop()  {  quit = true;  }
+
+	//  game thread: take commands round robin, at most perSession from each
+	void Drain(std::vector<REMOTE_CMD>& out, unsigned int perSession);
+
+	size_t queueMax;  // per session
+	unsigned int idleSec;  // close sessions without messages this long, 0 never
+	std::ostream* log;  // new sessions and bad messages, if set
+	//  game thread: copy of its receive to apply times, for the latency cmd
+	void PublishLatency(const HISTOGRAM_US& h);
+	METRIC_COUNTER* received;  // commands parsed, if set
+	bool admin;  // shared commands from anyone, also from shm
+
+	//  game thread: car count at race start, for the owns all cars check
+	void SetCars(unsigned int count);
+	//  game thread: drop local (shm) commands from index from on, that a session
+	//  would be denied, returns how many
+	size_t CheckLocal(std::vector<REMOTE_CMD>& cmds, size_t from);
+
+private:
+	//  server thread, returns reply text
+	const char* Handle(const std::string& id, const std::vector<REMOTE_CMD>& batch, bool parsedOk);
+
+	boost::mutex mutex;  // guards all below
+	typedef std::map<std::string, REMOTE_SESSION> Sessions;
+	Sessions sessions;
+	std::map<int, std::string> owners;  // car id -> session id
+	size_t rrStart;  // session to start with next Drain
+	HISTOGRAM_US latency;  // last published
+
+	void Close(Sessions::iterator si);  // frees its cars
+	bool OwnsAll(const std::string& id) const;
+	unsigned int cars;
+	void CloseIdle(unsigned long long now);  // once a second, from both threads
+	unsigned long long idleCheckUs;
+	std::string replyText;  // server thread
+	volatile bool quit;
+};
@@ -0,0 +1,128 @@
+#include "pch.h"
+#include "shm_transport.h"
+#include "atomic_ops.h"
+#include "car.h"
+#include <cstring>
+#ifndef _WIN32
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+using namespace std;
+
+#define SHM_BARRIER()  AtomicFence()
+
+
+SHM_TRANSPORT::SHM_TRANSPORT()
+	: shm(NULL)
+{	}
+
+SHM_TRANSPORT::~SHM_TRANSPORT()
+{
+	Close();
+}
+
+bool SHM_TRANSPORT::Open(const string& n, ostream& error_output)
+{
+#ifdef _WIN32
+	error_output << "Shared memory transport not supported on this platform" << endl;
+	return false;
+#else
+	Close();
+	name = n[0] == '/' ? n : "/" + n;
+	int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0600);
+	if (fd < 0)
+	{	error_output << "Can't open shared memory: " << name << endl;
+		return false;
+	}
+	if (ftruncate(fd, sizeof(SHM_LAYOUT)) != 0)
+	{	error_output << "Can't size shared memory: " << name << endl;
+		close(fd);  shm_unlink(name.c_str());
+		return false;
+	}
+	void* p = mmap(NULL, sizeof(SHM_LAYOUT), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED)
+	{	error_output << "Can't map shared memory: " << name << endl;
+		shm_unlink(name.c_str());
+		return false;
+	}
+	shm = (SHM_LAYOUT*)p;
+	memset(shm, 0, sizeof(SHM_LAYOUT));
+	shm->hdr.version = 1;
+	shm->hdr.ringSize = SHM_RING;
+	shm->hdr.carsMax = SHM_CARS;
+	SHM_BARRIER();
+	shm->hdr.magic = SHM_MAGIC;  // last, agents wait for it
+	return true;
+#endif
+}
+
+void SHM_TRANSPORT::Close()
+{
+#ifndef _WIN32
+	if (!shm)  return;
+	shm->hdr.magic = 0;
+	munmap(shm, sizeof(SHM_LAYOUT));
+	shm_unlink(name.c_str());
+	shm = NULL;
+#endif
+}
+
+
+///  input ring, single consumer
+//-----------------------------------------------------------
+void SHM_TRANSPORT::GetCmds(vector<REMOTE_CMD>& out)
+{
+	if (!shm)  return;
+	unsigned int head = shm->hdr.head, tail = shm->hdr.tail;
+	SHM_BARRIER();  // read slots after head
+
+	//  agent went past the ring, skip what was overwritten
+	if (head - tail > SHM_RING)
+		tail = head - SHM_RING;
+
+	for (; tail != head; ++tail)
+	{
+		const SHM_CMD& c = shm->ring[tail & (SHM_RING-1)];
+		if (c.type <= REMOTE_CMD::NONE || c.type >= REMOTE_CMD::ALL)
+			continue;
+		REMOTE_CMD cmd;
+		cmd.type = (REMOTE_CMD::TYPE)c.type;
+		cmd.car = c.car;  cmd.value = c.value;  cmd.param = (short)c.pad;
+		out.push_back(cmd);
+	}
+	SHM_BARRIER();  // done reading before freeing slots
+	shm->hdr.tail = tail;
+}
+
+
+///  telemetry, seqlock writer
+//-----------------------------------------------------------
+void SHM_TRANSPORT::SetCars(unsigned int count)
+{
+	if (shm)
+		shm->hdr.cars = count < SHM_CARS ? count : SHM_CARS;
+}
+
+void SHM_TRANSPORT::Publish(unsigned int frame, int slot, CAR& car)
+{
+	if (!shm || slot < 0 || slot >= (int)SHM_CARS)  return;
+	SHM_CAR& c = shm->cars[slot];
+
+	MATHVECTOR<float,3> pos = car.GetPosition(), vel = car.GetVelocity();
+	QUATERNION<float> rot = car.GetOrientation();
+
+	++c.seq;  // odd, writing
+	SHM_BARRIER();
+	c.frame = frame;  c.id = car.id;
+	for (int i=0; i < 3; ++i)  {  c.pos[i] = pos[i];  c.vel[i] = vel[i];  }
+	for (int i=0; i < 4; ++i)  c.rot[i] = rot[i];
+	c.speed = car.GetSpeed();
+	c.boostFuel = car.dynamics.boostFuel;
+	SHM_BARRIER();
+	++c.seq;  // even, done
+
+	shm->hdr.frame = frame;
+}
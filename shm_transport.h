@@ -0,0 +1,79 @@
+#pragma once
+#include "remote_cmd.h"
+#include <string>
+#include <vector>
+#include <ostream>
+
+
+///  shared memory control and telemetry for agents on the same host
+//  POSIX shm segment (shm_open name), layout:
+//    SHM_HEADER
+//    SHM_CMD ring[SHM_RING]      agent writes at head, game reads at tail
+//    SHM_CAR cars[SHM_CARS]      game writes once per physics frame
+//  one writer per side, no locks: ring indices are atomic counters,
+//  telemetry is guarded by a seqlock (seq odd while writing, reader retries)
+
+const unsigned int SHM_MAGIC = 0x53524D31;  // "SRM1"
+const unsigned int SHM_RING = 1024;  // power of 2
+const unsigned int SHM_CARS = 16;
+
+struct SHM_CMD
+{
+	int type;  // REMOTE_CMD::TYPE
+	int car;
+	float value;
+	unsigned int pad;  // REMOTE_CMD::param
+};
+
+struct SHM_CAR
+{
+	volatile unsigned int seq;
+	unsigned int frame;  // race frame
+	float pos[3], rot[4], vel[3];  // rot x,y,z,w
+	float speed, boostFuel;
+	int id;
+};
+
+struct SHM_HEADER
+{
+	unsigned int magic, version;
+	unsigned int ringSize, carsMax;
+	volatile unsigned int cars;  // in use
+	volatile unsigned int frame;  // last published race frame
+	char pad0[40];
+	volatile unsigned int head;  // agent: next slot to write
+	char pad1[60];
+	volatile unsigned int tail;  // game: next slot to read
+	char pad2[60];
+};
+
+struct SHM_LAYOUT
+{
+	SHM_HEADER hdr;
+	SHM_CMD ring[SHM_RING];
+	SHM_CAR cars[SHM_CARS];
+};
+
+
+class CAR;
+
+class SHM_TRANSPORT
+{
+public:
+	SHM_TRANSPORT();
+	~SHM_TRANSPORT();
+
+	bool Open(const std::string& name, std::ostream& error_output);
+	void Close();
+	bool IsOpen() const  {  return shm != NULL;  }
+
+	//  game thread, at the start of a physics frame
+	void GetCmds(std::vector<REMOTE_CMD>& out);
+	//  game thread, after the frame
+	void Publish(unsigned int frame, int slot, CAR& car);
+	void SetCars(unsigned int count);
+
+private:
+	std::string name;
+	SHM_LAYOUT* shm;
+};
@@ -0,0 +1,256 @@
+#include "pch.h"
+#include "sim_farm.h"
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <deque>
+#ifndef _WIN32
+	#include <signal.h>
+	#include <sys/socket.h>
+	#include <sys/types.h>
+	#include <sys/wait.h>
+	#include <poll.h>
+	#include <unistd.h>
+#endif
+using namespace std;
+
+
+SIM_FARM::SIM_FARM()
+	: index(-1), fd(-1)
+{	}
+
+SIM_FARM::~SIM_FARM()
+{
+#ifndef _WIN32
+	if (fd >= 0)  close(fd);
+	for (size_t i = 0; i < fds.size(); ++i)
+		if (fds[i] >= 0)  close(fds[i]);
+#endif
+}
+
+int SIM_FARM::Fork(int workers, ostream& error_output, bool& ok)
+{
+	ok = false;
+#ifdef _WIN32
+	error_output << "Sim farm: not supported on this platform" << endl;
+	return -1;
+#else
+	for (int i = 0; i < workers; ++i)
+	{
+		int sv[2];
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0)
+		{	error_output << "Sim farm: socketpair failed" << endl;
+			return -1;
+		}
+		pid_t pid = fork();
+		if (pid < 0)
+		{	error_output << "Sim farm: fork failed" << endl;
+			close(sv[0]);  close(sv[1]);
+			return -1;
+		}
+		if (pid == 0)
+		{	//  worker
+			close(sv[0]);
+			for (size_t f = 0; f < fds.size(); ++f)
+				close(fds[f]);
+			fds.clear();  pids.clear();
+			fd = sv[1];  index = i;
+			ok = true;
+			return i;
+		}
+		close(sv[1]);
+		fds.push_back(sv[0]);
+		pids.push_back(pid);
+	}
+	ok = true;
+	return -1;
+#endif
+}
+
+
+///  line I/O
+//-----------------------------------------------------------
+bool SIM_FARM::Send(int f, const string& line)
+{
+#ifndef _WIN32
+	string s = line + "\n";
+	const char* p = s.c_str();
+	size_t left = s.size();
+	while (left > 0)
+	{
+		ssize_t n = write(f, p, left);
+		if (n <= 0)  return false;
+		p += n;  left -= n;
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool SIM_FARM::ReadLine(int f, string& b, string& line)
+{
+#ifndef _WIN32
+	size_t nl;
+	while ((nl = b.find('\n')) == string::npos)
+	{
+		char tmp[512];
+		ssize_t n = read(f, tmp, sizeof(tmp));
+		if (n <= 0)  return false;
+		b.append(tmp, n);
+	}
+	line = b.substr(0, nl);
+	b.erase(0, nl + 1);
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+///  master
+//-----------------------------------------------------------
+bool SIM_FARM::RunMaster(const string& specsPath, const string& resultsPath,
+	ostream& info_output, ostream& error_output)
+{
+#ifdef _WIN32
+	return false;
+#else
+	vector<string> specs;
+	ifstream fs(specsPath.c_str());
+	string line;
+	while (getline(fs, line))
+		if (!line.empty() && line[0] != '#')
+			specs.push_back(line);
+	if (specs.empty())
+		error_output << "Sim farm: no runs in specs file: " << specsPath << endl;
+
+	ofstream res(resultsPath.c_str());
+	info_output << "Sim farm: " << specs.size() << " runs on " << fds.size() << " workers" << endl;
+
+	//  a dead worker's socket gives EPIPE on write, not a signal killing the master
+	signal(SIGPIPE, SIG_IGN);
+
+	size_t next = 0, done = 0, alive = fds.size();
+	vector<string> bufs(fds.size());
+	vector<pollfd> pfd(fds.size());
+	vector<int> running(fds.size(), -1);  // run id on each worker
+	vector<bool> ready(fds.size(), false);  // waiting for a run
+	vector<bool> lost(fds.size(), false);
+	vector<int> tries(specs.size(), 0);
+	deque<int> requeue;  // runs of lost workers, given out before new ones
+
+	while (alive > 0)
+	{
+		for (size_t i = 0; i < fds.size(); ++i)
+		{	pfd[i].fd = fds[i];  pfd[i].events = POLLIN;  pfd[i].revents = 0;  }
+		if (poll(&pfd[0], pfd.size(), -1) < 0)
+			break;
+
+		for (size_t i = 0; i < fds.size(); ++i)
+		{
+			if (fds[i] < 0 || !(pfd[i].revents & (POLLIN | POLLHUP | POLLERR)))
+				continue;
+			//  one read, then every whole line we have
+			do
+			{	if (!ReadLine(fds[i], bufs[i], line))
+				{	lost[i] = true;
+					break;
+				}
+				if (line.compare(0, 5, "DONE ") == 0)
+				{
+					res << line.substr(5) << endl;
+					++done;  running[i] = -1;
+				}
+				else if (line == "READY")
+					ready[i] = true;
+			}
+			while (bufs[i].find('\n') != string::npos);
+		}
+
+		//  until no worker is lost on send, a requeued run can go to any ready one
+		bool again = true;
+		while (again)
+		{
+			again = false;
+			//  dead workers (read end or EPIPE), their run goes to another one once
+			for (size_t i = 0; i < fds.size(); ++i)
+			{
+				if (!lost[i])
+					continue;
+				error_output << "Sim farm: worker " << i << " lost" << endl;
+				int run = running[i];
+				if (run >= 0 && tries[run] < 2)
+				{	requeue.push_back(run);
+					error_output << "Sim farm: run " << run << " requeued" << endl;
+				}
+				else if (run >= 0)
+					res << run << " 0 worker lost twice" << endl;
+				close(fds[i]);  fds[i] = -1;  --alive;
+				running[i] = -1;  ready[i] = false;  lost[i] = false;
+			}
+
+			//  ready workers wait while others run, those could still be requeued
+			bool busy = false;
+			for (size_t i = 0; i < fds.size(); ++i)
+				busy = busy || running[i] >= 0;
+			for (size_t i = 0; i < fds.size() && !again; ++i)
+			{
+				if (fds[i] < 0 || !ready[i])
+					continue;
+				int run = -1;
+				if (!requeue.empty())
+				{	run = requeue.front();  requeue.pop_front();  }
+				else if (next < specs.size())
+					run = (int)next++;
+
+				if (run >= 0)
+				{	ostringstream s;  s << "RUN " << run << " " << specs[run];
+					running[i] = run;  ++tries[run];  ready[i] = false;
+					if (!Send(fds[i], s.str()))
+						lost[i] = again = true;
+					busy = true;
+				}
+				else if (!busy)
+				{	Send(fds[i], "QUIT");
+					close(fds[i]);  fds[i] = -1;  --alive;  ready[i] = false;
+				}
+			}
+		}
+	}
+	//  last workers died with runs left
+	if (next < specs.size() || !requeue.empty())
+		error_output << "Sim farm: no workers left, " << specs.size() - next + requeue.size() << " runs not done" << endl;
+
+	for (size_t i = 0; i < pids.size(); ++i)
+		waitpid(pids[i], NULL, 0);
+	info_output << "Sim farm: " << done << " of " << specs.size() << " runs done, results: " << resultsPath << endl;
+	return done == specs.size();
+#endif
+}
+
+
+///  worker
+//-----------------------------------------------------------
+bool SIM_FARM::NextRun(string& script, int& runId)
+{
+	if (fd < 0 || !Send(fd, "READY"))
+		return false;
+	string line;
+	if (!ReadLine(fd, buf, line) || line.compare(0, 4, "RUN ") != 0)
+		return false;  // QUIT or master gone
+
+	size_t sp = line.find(' ', 4);
+	if (sp == string::npos)
+		return false;
+	runId = atoi(line.c_str() + 4);
+	script = line.substr(sp + 1);
+	return true;
+}
+
+void SIM_FARM::RunDone(int runId, bool ok, const string& report)
+{
+	ostringstream s;
+	s << "DONE " << runId << " " << (ok ? 1 : 0) << " " << report;
+	Send(fd, s.str());
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <ostream>
+
+
+///  sim farm, many scripted runs over a few game processes
+//  the master loads shared data once (carsim), forks workers which share it
+//  copy on write, then hands out run specs (benchmark script paths, one per line
+//  in the specs file) over a socket pair per worker and collects results
+//
+//  a run whose worker dies is given to another worker once, then reported failed
+//  protocol, one line each:  worker: READY | DONE id ok report   master: RUN id script | QUIT
+class SIM_FARM
+{
+public:
+	SIM_FARM();
+	~SIM_FARM();
+
+	//  returns worker index in each child, -1 in the master (or on error, see ok)
+	int Fork(int workers, std::ostream& error_output, bool& ok);
+
+	//  master, blocks until all specs are done and workers have quit
+	bool RunMaster(const std::string& specsPath, const std::string& resultsPath,
+		std::ostream& info_output, std::ostream& error_output);
+
+	//  worker
+	bool IsWorker() const  {  return index >= 0;  }
+	bool NextRun(std::string& script, int& runId);  // false = quit
+	void RunDone(int runId, bool ok, const std::string& report);
+
+	int index;  // worker index, -1 in master
+
+private:
+	bool Send(int fd, const std::string& line);
+	bool ReadLine(int fd, std::string& buf, std::string& line);
+
+	int fd;  // worker: to master
+	std::string buf;
+	std::vector<int> fds;  // master: to each worker
+	std::vector<int> pids;
+};
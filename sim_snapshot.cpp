@@ -0,0 +1,141 @@
+#include "pch.h"
+#include "sim_snapshot.h"
+#include <cstring>
+#include "btBulletDynamicsCommon.h"
+using namespace std;
+
+
+//  one rigid body, copied raw into the buffer
+struct BODY_STATE
+{
+	btTransform tr, interpTr;
+	btVector3 linVel, angVel, interpLinVel, interpAngVel;
+	btScalar deactivationTime;
+	int activationState;
+};
+
+static bool IsDynamic(const btCollisionObject* co, const btRigidBody*& rb)
+{
+	rb = btRigidBody::upcast(co);
+	return rb && !rb->isStaticObject();
+}
+
+
+void SIM_SNAPSHOT::CAR_STATE::Save(const CARDYNAMICS& cd)
+{
+	engine = cd.engine;  clutch = cd.clutch;  transmission = cd.transmission;
+	diffFront = cd.diff_front;  diffRear = cd.diff_rear;  diffCenter = cd.diff_center;
+	for (int w=0; w < 4; ++w)
+	{	wheel[w] = cd.wheel[w];  suspension[w] = cd.suspension[w];  brake[w] = cd.brake[w];  }
+	shifted = cd.shifted;  shiftGear = cd.shift_gear;
+	lastAutoClutch = cd.last_auto_clutch;  remainingShiftTime = cd.remaining_shift_time;
+	boostFuel = cd.boostFuel;
+}
+
+void SIM_SNAPSHOT::CAR_STATE::Restore(CARDYNAMICS& cd) const
+{
+	cd.engine = engine;  cd.clutch = clutch;  cd.transmission = transmission;
+	cd.diff_front = diffFront;  cd.diff_rear = diffRear;  cd.diff_center = diffCenter;
+	for (int w=0; w < 4; ++w)
+	{	cd.wheel[w] = wheel[w];  cd.suspension[w] = suspension[w];  cd.brake[w] = brake[w];  }
+	cd.shifted = shifted;  cd.shift_gear = shiftGear;
+	cd.last_auto_clutch = lastAutoClutch;  cd.remaining_shift_time = remainingShiftTime;
+	cd.boostFuel = boostFuel;
+}
+
+
+SIM_SNAPSHOT::SIM_SNAPSHOT()
+	: valid(false), race_frame(0), bodyCount(0)
+{	}
+
+void SIM_SNAPSHOT::Save(btDynamicsWorld* world, list<CAR>& cl, const TIMER& t,
+	const vector<REMOTE_INPUT>& in, unsigned int frame)
+{
+	//  bodies
+	const btCollisionObjectArray& objs = world->getCollisionObjectArray();
+	bodies.resize(objs.size() * sizeof(BODY_STATE));
+	bodyCount = 0;
+	char* p = bodies.empty() ? NULL : &bodies[0];
+	for (int i = 0; i < objs.size(); ++i)
+	{
+		const btRigidBody* rb;
+		if (!IsDynamic(objs[i], rb))
+			continue;
+		BODY_STATE s;
+		s.tr = rb->getWorldTransform();
+		s.interpTr = rb->getInterpolationWorldTransform();
+		s.linVel = rb->getLinearVelocity();
+		s.angVel = rb->getAngularVelocity();
+		s.interpLinVel = rb->getInterpolationLinearVelocity();
+		s.interpAngVel = rb->getInterpolationAngularVelocity();
+		s.deactivationTime = rb->getDeactivationTime();
+		s.activationState = rb->getActivationState();
+		memcpy(p, &s, sizeof(s));
+		p += sizeof(s);  ++bodyCount;
+	}
+	bodies.resize(bodyCount * sizeof(BODY_STATE));
+
+	//  cars, timer, inputs
+	cars.resize(cl.size());
+	int i = 0;
+	for (list<CAR>::iterator c = cl.begin(); c != cl.end(); ++c, ++i)
+		cars[i].Save(c->dynamics);
+	timer = t;
+	inputs = in;
+	race_frame = frame;
+	valid = true;
+}
+
+bool SIM_SNAPSHOT::Restore(btDynamicsWorld* world, list<CAR>& cl, TIMER& t,
+	vector<REMOTE_INPUT>& in, unsigned int& frame) const
+{
+	if (!valid || cars.size() != cl.size())
+		return false;
+
+	const btCollisionObjectArray& objs = world->getCollisionObjectArray();
+	int count = 0;
+	for (int i = 0; i < objs.size(); ++i)
+	{	const btRigidBody* rb;
+		if (IsDynamic(objs[i], rb))  ++count;
+	}
+	if (count != bodyCount)
+		return false;  // world changed since save
+
+	const char* p = bodies.empty() ? NULL : &bodies[0];
+	for (int i = 0; i < objs.size(); ++i)
+	{
+		const btRigidBody* crb;
+		if (!IsDynamic(objs[i], crb))
+			continue;
+		btRigidBody* rb = const_cast<btRigidBody*>(crb);
+		BODY_STATE s;
+		memcpy(&s, p, sizeof(s));
+		p += sizeof(s);
+
+		rb->setWorldTransform(s.tr);
+		rb->setCenterOfMassTransform(s.tr);
+		rb->setInterpolationWorldTransform(s.interpTr);
+		if (rb->getMotionState())
+			rb->getMotionState()->setWorldTransform(s.tr);
+		rb->setLinearVelocity(s.linVel);
+		rb->setAngularVelocity(s.angVel);
+		rb->setInterpolationLinearVelocity(s.interpLinVel);
+		rb->setInterpolationAngularVelocity(s.interpAngVel);
+		rb->clearForces();
+		rb->forceActivationState(s.activationState);
+		rb->setDeactivationTime(s.deactivationTime);
+
+		//  old contacts are for other positions
+		if (rb->getBroadphaseHandle())
+			world->getBroadphase()->getOverlappingPairCache()->cleanProxyFromPairs(
+				rb->getBroadphaseHandle(), world->getDispatcher());
+	}
+
+	int i = 0;
+	for (list<CAR>::iterator c = cl.begin(); c != cl.end(); ++c, ++i)
+		cars[i].Restore(c->dynamics);
+	t = timer;
+	in = inputs;
+	frame = race_frame;
+	return true;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "car.h"
+#include "timer.h"
+#include "remote_cmd.h"
+#include <vector>
+#include <list>
+
+class btDynamicsWorld;
+
+
+///  saved simulation state, to branch and roll back a race
+//  holds all non static bullet bodies (in world order, packed into a byte buffer,
+//  this has each car's chassis), each car's CARDYNAMICS state outside bullet
+//  (drivetrain, wheels, suspension, brakes, shifting, boost), TIMER and remote
+//  input overrides; restore needs the same cars and bodies as when saved
+class SIM_SNAPSHOT
+{
+public:
+	SIM_SNAPSHOT();
+	enum {  SLOTS = 16  };  // snap N, N in 0..SLOTS-1
+
+	void Save(btDynamicsWorld* world, std::list<CAR>& cars, const TIMER& timer,
+		const std::vector<REMOTE_INPUT>& inputs, unsigned int race_frame);
+	bool Restore(btDynamicsWorld* world, std::list<CAR>& cars, TIMER& timer,
+		std::vector<REMOTE_INPUT>& inputs, unsigned int& race_frame) const;
+
+	bool valid;
+	unsigned int race_frame;
+	size_t Bytes() const  {  return bodies.size() + cars.size() * sizeof(CAR_STATE);  }
+
+private:
+	//  copied by value, these don't own bullet objects
+	struct CAR_STATE
+	{
+		CARENGINE engine;  // rpm
+		CARCLUTCH clutch;
+		CARTRANSMISSION transmission;  // gear
+		CARDIFFERENTIAL diffFront, diffRear, diffCenter;
+		CARWHEEL wheel[4];  // spin
+		CARSUSPENSION suspension[4];  // displacement
+		CARBRAKE brake[4];
+		bool shifted;  int shiftGear;
+		Dbl lastAutoClutch, remainingShiftTime;
+		float boostFuel;
+
+		void Save(const CARDYNAMICS& cd);
+		void Restore(CARDYNAMICS& cd) const;
+	};
+	std::vector<char> bodies;
+	int bodyCount;
+	std::vector<CAR_STATE> cars;
+	TIMER timer;
+	std::vector<REMOTE_INPUT> inputs;
+};
@@ -0,0 +1,147 @@
+#include "pch.h"
+#include "startup_graph.h"
+#include "timeus.h"
+#include "json_str.h"
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+using namespace std;
+
+
+STARTUP_GRAPH::STARTUP_GRAPH()
+	: runFrom(0), left(0)
+{	}
+
+int STARTUP_GRAPH::Add(const string& name, FN fn)
+{
+	STAGE s;
+	s.name = name;  s.fn = fn;  s.waits = 0;
+	s.begin = s.end = 0;  s.thread = -1;
+	stages.push_back(s);
+	return (int)stages.size() - 1;
+}
+
+int STARTUP_GRAPH::Add(const string& name, FN fn, int after)
+{
+	int id = Add(name, fn);
+	if (after >= (int)runFrom)  // already run ones are done
+	{	stages[after].next.push_back(id);
+		++stages[id].waits;
+	}
+	return id;
+}
+
+int STARTUP_GRAPH::Add(const string& name, FN fn, int after, int after2)
+{
+	int id = Add(name, fn, after);
+	if (after2 >= (int)runFrom)
+	{	stages[after2].next.push_back(id);
+		++stages[id].waits;
+	}
+	return id;
+}
+
+void STARTUP_GRAPH::Record(const string& name, unsigned long long beginUs, unsigned long long endUs)
+{
+	STAGE s;
+	s.name = name;  s.waits = 0;
+	s.begin = beginUs;  s.end = endUs;  s.thread = 0;
+	stages.push_back(s);
+	if (runFrom == stages.size() - 1)
+		++runFrom;
+}
+
+
+///  run
+//-----------------------------------------------------------
+void STARTUP_GRAPH::Run(int threads)
+{
+	{	boost::lock_guard<boost::mutex> lock(mutex);
+		ready.clear();
+		left = 0;
+		for (size_t i = runFrom; i < stages.size(); ++i)
+			if (stages[i].fn)
+			{	++left;
+				if (stages[i].waits == 0)
+					ready.push_back((int)i);
+			}
+	}
+	vector<boost::thread*> th;
+	for (int t = 1; t < threads && t < (int)left; ++t)
+		th.push_back(new boost::thread(&STARTUP_GRAPH::Thread, this, t));
+	Thread(0);  // caller works too
+
+	for (size_t t = 0; t < th.size(); ++t)
+	{	th[t]->join();
+		delete th[t];
+	}
+	runFrom = stages.size();
+}
+
+void STARTUP_GRAPH::Thread(int thread)
+{
+	boost::unique_lock<boost::mutex> lock(mutex);
+	while (true)
+	{
+		while (ready.empty() && left > 0)
+			cond.wait(lock);
+		if (left == 0)
+			break;
+		int i = ready.back();  ready.pop_back();
+
+		lock.unlock();
+		STAGE& s = stages[i];  // vector isn't resized while running
+		s.thread = thread;
+		s.begin = GetTimeUs();
+		s.fn();
+		s.end = GetTimeUs();
+		lock.lock();
+
+		for (size_t n = 0; n < s.next.size(); ++n)
+			if (--stages[s.next[n]].waits == 0)
+				ready.push_back(s.next[n]);
+		--left;
+		cond.notify_all();
+	}
+}
+
+
+///  report
+//-----------------------------------------------------------
+string STARTUP_GRAPH::Summary() const
+{
+	unsigned long long t0 = ~0ull, t1 = 0, sum = 0;
+	for (size_t i = 0; i < stages.size(); ++i)
+	{	t0 = min(t0, stages[i].begin);  t1 = max(t1, stages[i].end);
+		sum += stages[i].end - stages[i].begin;
+	}
+	ostringstream s;
+	s << "Startup: " << (stages.empty() ? 0 : (t1 - t0) / 1000) << " ms, stages " << sum / 1000 << " ms:";
+	for (size_t i = 0; i < stages.size(); ++i)
+		s << " " << stages[i].name << " " << (stages[i].end - stages[i].begin) / 1000;
+	return s.str();
+}
+
+bool STARTUP_GRAPH::WriteReport(const string& path, ostream& error_output) const
+{
+	ofstream f(path.c_str());
+	if (!f)
+	{	error_output << "Startup: can't write report: " << path << endl;
+		return false;
+	}
+	unsigned long long t0 = ~0ull, t1 = 0;
+	for (size_t i = 0; i < stages.size(); ++i)
+	{	t0 = min(t0, stages[i].begin);  t1 = max(t1, stages[i].end);  }
+	if (stages.empty())  t0 = t1 = 0;
+
+	f << "{\n  \"total_ms\": " << (t1 - t0) * 0.001 << ",\n  \"stages\": [\n";
+	for (size_t i = 0; i < stages.size(); ++i)
+	{
+		const STAGE& s = stages[i];
+		f << "    { \"name\": " << JsonStr(s.name) << ", \"start_ms\": " << (s.begin - t0) * 0.001
+		  << ", \"ms\": " << (s.end - s.begin) * 0.001 << ", \"thread\": " << s.thread << " }"
+		  << (i + 1 < stages.size() ? "," : "") << "\n";
+	}
+	f << "  ]\n}\n";
+	return true;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <ostream>
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
+
+///  startup stages as a task graph
+//  a stage runs when the stages it comes after are done, stages without
+//  a path between them run at the same time on up to N threads
+//  every stage's start and time go into the report, also ones timed
+//  outside (Record), so one report covers the whole startup
+class STARTUP_GRAPH
+{
+public:
+	typedef boost::function<void()> FN;
+
+	STARTUP_GRAPH();
+
+	//  returns stage id, for later stages' after
+	int Add(const std::string& name, FN fn);
+	int Add(const std::string& name, FN fn, int after);
+	int Add(const std::string& name, FN fn, int after, int after2);
+
+	//  runs all added stages, returns when all are done
+	void Run(int threads);
+
+	//  stage done elsewhere, times from GetTimeUs
+	void Record(const std::string& name, unsigned long long beginUs, unsigned long long endUs);
+
+	std::string Summary() const;  // one line
+	bool WriteReport(const std::string& path, std::ostream& error_output) const;  // json
+
+private:
+	struct STAGE
+	{	std::string name;
+		FN fn;
+		std::vector<int> next;  // stages after this
+		int waits;  // stages before, not done yet
+		unsigned long long begin, end;
+		int thread;
+	};
+	std::vector<STAGE> stages;
+	size_t runFrom;  // not run yet
+
+	boost::mutex mutex;
+	boost::condition_variable cond;
+	std::vector<int> ready;
+	size_t left;  // this Run
+
+	void Thread(int thread);
+};
@@ -0,0 +1,24 @@
+#pragma once
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <time.h>
+#endif
+
+///  monotonic time in microseconds, safe to call from any thread
+inline unsigned long long GetTimeUs()
+{
+#ifdef _WIN32
+	static LARGE_INTEGER freq = {0};
+	if (freq.QuadPart == 0)
+		QueryPerformanceFrequency(&freq);
+	LARGE_INTEGER t;
+	QueryPerformanceCounter(&t);
+	return (unsigned long long)(t.QuadPart / freq.QuadPart * 1000000ull
+		+ t.QuadPart % freq.QuadPart * 1000000ull / freq.QuadPart);
+#else
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+#endif
+}
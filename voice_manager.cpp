@@ -0,0 +1,134 @@
+#include "pch.h"
+#include "voice_manager.h"
+#include "car.h"
+#include "sound.h"
+#include "btBulletDynamicsCommon.h"
+#include <algorithm>
+#include <cfloat>
+using namespace std;
+
+
+VOICE_MANAGER::VOICE_MANAGER()
+	: budget(48), maxDist(250.f), aiPriority(0.5f), swaps(0)
+	, timer(0.f), activeVoices(0), activeGroups(0)
+{	}
+
+void VOICE_MANAGER::Build(list<CAR>& cars, const vector<char>& aiById)
+{
+	groups.clear();
+	groups.reserve(cars.size());
+	buffers.clear();
+	for (list<CAR>::iterator it = cars.begin(); it != cars.end(); ++it)
+	{
+		groups.push_back(GROUP());
+		GROUP& g = groups.back();
+		g.car = &*it;  g.active = false;
+		bool ai = it->id >= 0 && it->id < (int)aiById.size() && aiById[it->id];
+		g.priority = ai ? aiPriority : 1.f;
+		it->GetSoundList(g.src);
+
+		//  cars of one type share buffers, few of them
+		for (SOURCES::const_iterator s = g.src.begin(); s != g.src.end(); ++s)
+		{
+			const SOUNDBUFFER* sb = &(*s)->GetSoundBuffer();
+			size_t b = 0;
+			while (b < buffers.size() && buffers[b].buf != sb)  ++b;
+			if (b == buffers.size())
+			{	BUFFER nb;  nb.buf = sb;  nb.voices = 0;  nb.peak = 0;
+				buffers.push_back(nb);
+			}
+			g.buf.push_back((int)b);
+		}
+	}
+	order.resize(groups.size());
+	score.resize(groups.size());
+	want.resize(groups.size());
+	timer = 0.f;  activeVoices = 0;  activeGroups = 0;
+}
+
+void VOICE_MANAGER::Set(SOUND& sound, GROUP& g, bool on)
+{
+	if (g.active == on)  return;
+	int k = 0;
+	for (SOURCES::iterator s = g.src.begin(); s != g.src.end(); ++s, ++k)
+	{
+		BUFFER& b = buffers[g.buf[k]];
+		if (on)
+		{	sound.AddSource(**s);
+			if (++b.voices > b.peak)  b.peak = b.voices;
+		}else
+		{	sound.RemoveSource(*s);
+			--b.voices;
+		}
+	}
+	g.active = on;
+	++swaps;
+}
+
+struct ByScore
+{
+	const float* score;
+	bool operator()(int a, int b) const  {  return score[a] > score[b] || (score[a] == score[b] && a < b);  }
+};
+
+void VOICE_MANAGER::Update(SOUND& sound, const CAR* listener, float dt, bool force)
+{
+	timer -= dt;
+	if (!force && timer > 0.f)
+		return;
+	timer = 0.1f;
+	if (groups.empty())  return;
+
+	//  score: gain (as set by the car's last update) * priority / distance,
+	//  higher first, 0 not heard; kept ones a bit higher so they don't flicker
+	//  no listener (menu, replay start): no distance, only gain and priority
+	btVector3 lp = listener ? listener->dynamics.chassis->getCenterOfMassPosition() : btVector3(0,0,0);
+	for (size_t i = 0; i < groups.size(); ++i)
+	{
+		GROUP& g = groups[i];
+		order[i] = (int)i;
+		if (g.car == listener)
+		{	score[i] = FLT_MAX;  // always
+			continue;
+		}
+		float gain = 0.f;
+		for (SOURCES::const_iterator s = g.src.begin(); s != g.src.end(); ++s)
+			gain += (*s)->GetGain();
+		float d = 1.f;
+		if (listener)
+		{	d = (g.car->dynamics.chassis->getCenterOfMassPosition() - lp).length();
+			if (d > maxDist)
+			{	score[i] = 0.f;  continue;  }
+			d = max(d, 1.f);
+		}
+		score[i] = gain * g.priority / d * (g.active ? 1.1f : 1.f);
+	}
+	ByScore by;  by.score = &score[0];
+	sort(order.begin(), order.end(), by);
+
+	//  take by score until budget, remove first, then add
+	want.assign(groups.size(), 0);
+	int voices = 0, n = 0;
+	for (size_t o = 0; o < order.size(); ++o)
+	{
+		int i = order[o];
+		int v = (int)groups[i].buf.size();
+		if (score[i] < FLT_MAX && (score[i] <= 0.f || voices + v > budget))
+			continue;  // listener's car is always heard
+		want[i] = 1;  voices += v;  ++n;
+	}
+	for (size_t i = 0; i < groups.size(); ++i)
+		if (!want[i])  Set(sound, groups[i], false);
+	for (size_t i = 0; i < groups.size(); ++i)
+		if (want[i])  Set(sound, groups[i], true);
+
+	activeVoices = voices;  activeGroups = n;
+}
+
+void VOICE_MANAGER::Clear(SOUND& sound)
+{
+	for (size_t i = 0; i < groups.size(); ++i)
+		Set(sound, groups[i], false);
+	groups.clear();  buffers.clear();
+	activeVoices = 0;  activeGroups = 0;
+}
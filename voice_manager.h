@@ -0,0 +1,63 @@
+#pragma once
+#include <list>
+#include <vector>
+
+class CAR;
+class SOUND;
+class SOUNDSOURCE;
+class SOUNDBUFFER;
+
+
+///  limits how many car sound sources SOUND mixes
+//  each car's sources (engine, tires, bumps, wind, crash, fluids ..) are a group,
+//  groups are given to SOUND by score until the voice budget is used:
+//  the listener's car always, then by loudness (sum of source gains) times
+//  priority (ai cars lower) over distance; too far or silent ones are never mixed
+//  chosen again 10 times a second, added/removed only when that changes
+class VOICE_MANAGER
+{
+public:
+	VOICE_MANAGER();
+
+	void Build(std::list<CAR>& cars, const std::vector<char>& aiById);  // at race start, no sources active yet
+	void Update(SOUND& sound, const CAR* listener, float dt, bool force = false);
+	void Clear(SOUND& sound);  // remove active sources
+
+	int budget;  // max voices
+	float maxDist;  // m, not heard further
+	float aiPriority;  // score factor for ai cars, others 1
+
+	//  stats
+	int ActiveVoices() const  {  return activeVoices;  }
+	int ActiveGroups() const  {  return activeGroups;  }
+	unsigned int swaps;  // group adds and removes
+
+	//  mixed voices per sound buffer (sample), e.g. how many engines play
+	int Buffers() const  {  return (int)buffers.size();  }
+	const SOUNDBUFFER* Buffer(int b) const  {  return buffers[b].buf;  }
+	int BufferVoices(int b) const  {  return buffers[b].voices;  }
+	int BufferPeak(int b) const  {  return buffers[b].peak;  }  // most at once this race
+
+private:
+	typedef std::list<SOUNDSOURCE*> SOURCES;
+	struct GROUP
+	{	CAR* car;
+		SOURCES src;
+		std::vector<int> buf;  // buffers index per source, in src order
+		float priority;
+		bool active;
+	};
+	struct BUFFER
+	{	const SOUNDBUFFER* buf;
+		int voices, peak;
+	};
+	std::vector<BUFFER> buffers;
+	std::vector<GROUP> groups;
+	std::vector<int> order;  // sized at Build, no allocs in Update
+	std::vector<float> score;
+	std::vector<char> want;
+	float timer;
+	int activeVoices, activeGroups;
+
+	void Set(SOUND& sound, GROUP& g, bool on);
+};
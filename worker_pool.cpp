@@ -0,0 +1,82 @@
+#include "pch.h"
+#include "worker_pool.h"
+#include "atomic_ops.h"
+
+
+WORKER_POOL::WORKER_POOL()
+	: generation(0), busy(0), quit(false), job(NULL), count(0), next(0)
+{	}
+
+WORKER_POOL::~WORKER_POOL()
+{
+	Stop();
+}
+
+void WORKER_POOL::Start(int workers)
+{
+	Stop();
+	quit = false;
+	for (int w = 1; w < workers; ++w)
+		threads.push_back(new boost::thread(&WORKER_POOL::Thread, this, w));
+}
+
+void WORKER_POOL::Stop()
+{
+	{	boost::lock_guard<boost::mutex> lock(mutex);
+		quit = true;
+	}
+	start.notify_all();
+	for (size_t i = 0; i < threads.size(); ++i)
+	{	threads[i]->join();
+		delete threads[i];
+	}
+	threads.clear();
+}
+
+void WORKER_POOL::Work(int worker)
+{
+	int i;
+	while ((i = AtomicAdd(next, 1)) < count)
+		job->Run(i, worker);
+}
+
+void WORKER_POOL::Thread(int worker)
+{
+	unsigned int seen = 0;
+	while (true)
+	{
+		{	boost::unique_lock<boost::mutex> lock(mutex);
+			while (!quit && generation == seen)
+				start.wait(lock);
+			if (quit)
+				return;
+			seen = generation;
+		}
+		Work(worker);
+
+		boost::lock_guard<boost::mutex> lock(mutex);
+		if (--busy == 0)
+			done.notify_one();
+	}
+}
+
+void WORKER_POOL::For(int n, JOB& j)
+{
+	if (n <= 0)  return;
+	if (threads.empty() || n == 1)
+	{	for (int i = 0; i < n; ++i)
+			j.Run(i, 0);
+		return;
+	}
+	{	boost::lock_guard<boost::mutex> lock(mutex);
+		job = &j;  count = n;  next = 0;
+		busy = (int)threads.size();
+		++generation;
+	}
+	start.notify_all();
+	Work(0);
+
+	boost::unique_lock<boost::mutex> lock(mutex);
+	while (busy > 0)
+		done.wait(lock);
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <vector>
+#include <boost/thread.hpp>
+
+
+///  fixed set of threads for parallel loops inside a tick
+//  For runs job.Run(i, worker) for i in 0..count-1 spread over the threads,
+//  the calling thread works too (as worker 0) and For returns when all are done
+class WORKER_POOL
+{
+public:
+	struct JOB
+	{
+		virtual ~JOB()  {  }
+		virtual void Run(int i, int worker) = 0;
+	};
+
+	WORKER_POOL();
+	~WORKER_POOL();
+
+	void Start(int workers);  // total, with the caller
+	void Stop();
+	int Workers() const  {  return (int)threads.size() + 1;  }
+
+	void For(int count, JOB& job);
+
+private:
+	void Thread(int worker);
+	void Work(int worker);
+
+	std::vector<boost::thread*> threads;
+	boost::mutex mutex;
+	boost::condition_variable start, done;
+	unsigned int generation;  // new For
+	int busy;  // threads still in this For
+	bool quit;
+
+	JOB* job;
+	int count;
+	volatile int next;  // index to take
+};